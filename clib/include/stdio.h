@@ -1,6 +1,9 @@
 #ifndef _STANDART_IO_H
 #define _STANDART_IO_H
 
+#define EOF (-1)
+
+int getchar();
 int putchar(int c);
 int puts(const char* str);
 int printf(const char *restrict fmt, ...);
@@ -0,0 +1,44 @@
+#ifndef _SYS_MEMSTAT_H
+#define _SYS_MEMSTAT_H
+
+#include <stdint.h>
+
+#define MEMSTAT_HIST_BUCKETS 16
+
+#define MEMSTAT_DUMP 0x1 // Also write the report to the serial port
+
+struct memstat {
+	uint32_t heapBlockSize;
+	uint32_t heapTotalBlocks;
+	uint32_t heapUsedBlocks;
+	uint32_t heapFreeBlocks;
+	uint32_t heapFreeExtents;
+	uint32_t heapLargestFree;
+	uint32_t heapFragmentation; // 0-100
+
+	// Compaction of movable blocks, fragmentation around the last run
+	uint32_t compactions;
+	uint32_t compactedBlocks;
+	uint32_t compactFragBefore;
+	uint32_t compactFragAfter;
+
+	uint32_t slabs;
+	uint32_t slabObjects;
+
+	uint32_t totalPages;
+	uint32_t freePages;
+
+	// Page sized slots of the swap file
+	uint32_t swapSlots;
+	uint32_t swapUsed;
+
+	// Calling process
+	uint32_t pageTables;
+	uint32_t residentPages;
+
+	uint32_t sizeHistogram[MEMSTAT_HIST_BUCKETS]; // kmalloc requests, bucket i up to 16 << i bytes
+};
+
+int memstat(struct memstat* stats, int flags);
+
+#endif
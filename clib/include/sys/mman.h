@@ -0,0 +1,22 @@
+#ifndef _SYS_MMAN_H
+#define _SYS_MMAN_H
+
+#include <stddef.h>
+
+#define PROT_NONE  0x0
+#define PROT_READ  0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC  0x4
+
+#define MAP_FIXED     0x1
+#define MAP_PRIVATE   0x2
+#define MAP_ANONYMOUS 0x4
+#define MAP_POPULATE  0x8
+
+#define MAP_FAILED ((void*)-1)
+
+void* mmap(void* addr, size_t length, int prot, int flags);
+int munmap(void* addr, size_t length);
+int mprotect(void* addr, size_t length, int prot);
+
+#endif
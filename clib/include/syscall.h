@@ -1,7 +1,16 @@
 #ifndef _SYSCALL_H
 #define _SYSCALL_H
 
+#define SYS_fork 2
+#define SYS_brk 45
+#define SYS_mmap 90
+#define SYS_munmap 91
 #define SYS_write 100
+#define SYS_read 101
+#define SYS_memstat 116
+#define SYS_mprotect 125
+#define SYS_nanosleep 162
+#define SYS_clock_gettime 265
 
 extern long do_syscall(long no, long arg1, long arg2, long arg3, long arg4);
 
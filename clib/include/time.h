@@ -0,0 +1,19 @@
+#ifndef _TIME_H
+#define _TIME_H
+
+#include <stdint.h>
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+struct timespec {
+	int32_t tv_sec;
+	int32_t tv_nsec;
+};
+
+typedef int clockid_t;
+
+int clock_gettime(clockid_t clock, struct timespec* tp);
+int nanosleep(const struct timespec* req, struct timespec* rem);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _UNISTD_H
+#define _UNISTD_H
+
+#include <stdint.h>
+
+int fork();
+
+int brk(void* addr);
+void* sbrk(intptr_t increment);
+
+#endif
@@ -0,0 +1,6 @@
+#include <sys/memstat.h>
+#include <syscall.h>
+
+int memstat(struct memstat* stats, int flags) {
+	return syscall(SYS_memstat, (long)stats, flags, 0, 0);
+}
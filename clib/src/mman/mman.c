@@ -0,0 +1,18 @@
+#include <sys/mman.h>
+#include <syscall.h>
+
+// Kernel errors come back as small negative values
+#define _IS_ERR(x) ((unsigned long)(x) >= (unsigned long)-4095)
+
+void* mmap(void* addr, size_t length, int prot, int flags) {
+	long res = syscall(SYS_mmap, (long)addr, (long)length, prot, flags);
+	return _IS_ERR(res) ? MAP_FAILED : (void*)res;
+}
+
+int munmap(void* addr, size_t length) {
+	return syscall(SYS_munmap, (long)addr, (long)length, 0, 0);
+}
+
+int mprotect(void* addr, size_t length, int prot) {
+	return syscall(SYS_mprotect, (long)addr, (long)length, prot, 0);
+}
@@ -0,0 +1,10 @@
+#include <stdio.h>
+#include <syscall.h>
+
+// Sleeps in the kernel until a key is typed
+int getchar(){
+	char ch;
+	long res = syscall(SYS_read, (long)&ch, 1, 0, 0);
+
+	return res == 1 ? (unsigned char)ch : EOF;
+}
@@ -0,0 +1,10 @@
+#include <time.h>
+#include <syscall.h>
+
+int clock_gettime(clockid_t clock, struct timespec* tp) {
+	return syscall(SYS_clock_gettime, clock, (long)tp, 0, 0);
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem) {
+	return syscall(SYS_nanosleep, (long)req, (long)rem, 0, 0);
+}
@@ -0,0 +1,26 @@
+#include <unistd.h>
+#include <syscall.h>
+
+int fork() {
+	return syscall(SYS_fork, 0, 0, 0, 0);
+}
+
+// The kernel returns the break in effect, asking for 0 only reads it
+int brk(void* addr) {
+	long res = syscall(SYS_brk, (long)addr, 0, 0, 0);
+	return res == (long)addr ? 0 : -1;
+}
+
+void* sbrk(intptr_t increment) {
+	long current = syscall(SYS_brk, 0, 0, 0, 0);
+	if (increment == 0) {
+		return (void*)current;
+	}
+
+	long requested = current + increment;
+	if (syscall(SYS_brk, requested, 0, 0, 0) != requested) {
+		return (void*)-1;
+	}
+
+	return (void*)current;
+}
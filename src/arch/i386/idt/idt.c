@@ -141,7 +141,11 @@ void __cdecl interrupt_handler(struct InterruptFrame* frame){
 		}
 	}
 
-	pic_send_eoi(interrupt);
+	// Local APIC vectors are acknowledged by their handlers
+	if(interrupt >= IRQ(0) && interrupt < IRQ(16)){
+		pic_send_eoi(interrupt);
+	}
+
 	user_registers();
 }
 
@@ -13,9 +13,6 @@
 #define PIC2_DATA	(PIC2+1)
 
 #define PIC_EOI       0x20
-#define PIC_CHANNEL0  0x40
-#define PIC_COMMAND   0x43
-#define PIC_FREQUENCY 1193182
 
 #define PIC_READ_IRR 0x0a
 #define PIC_READ_ISR 0x0b
@@ -31,10 +28,6 @@ static uint16_t __pic_get_irq_reg(int ocw3)
     return (inb(PIC2_COMMAND) << 8) | inb(PIC1_COMMAND);
 }
 
-static void _timer_iqr_handler(struct InterruptFrame* frame){
-	outb(PIC1_COMMAND, PIC_EOI);
-}
-
 // IRQ7 handler (slave PIC spurious check)
 static void _irq7_handler() {
     uint8_t isr = pic_get_isr();
@@ -61,16 +54,9 @@ static void _irq15_handler() {
     outb(PIC1_COMMAND, PIC_EOI);
 }
 
-void pic_init(uint32_t frequency) {
+// The PIT is programmed by the clock event layer, see arch/i386/timer
+void pic_init() {
 	pic_remap();
-
-	uint16_t divisor = (uint16_t)(PIC_FREQUENCY / frequency);
-
-	outb(PIC_CHANNEL0, 0x36);                  // Channel 0, lobyte/hibyte
-	outb(PIC_COMMAND, divisor & 0xFF);         // low end
-	outb(PIC_CHANNEL0, (divisor >> 8) & 0xFF); // high end
-
-	idt_register_callback(0x20, _timer_iqr_handler);
 }
 
 void pic_send_eoi(uint8_t irq)
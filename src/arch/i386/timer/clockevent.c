@@ -0,0 +1,137 @@
+#include <arch/i386/clockevent.h>
+#include <arch/i386/lapic.h>
+#include <arch/i386/pit.h>
+#include <arch/i386/pic.h>
+#include <arch/i386/idt.h>
+#include <def/err.h>
+#include <stdint.h>
+
+/*
+ * Clock events
+ *
+ * The timer interrupt only comes when someone asked for it. The local
+ * APIC timer is used when the CPU has one, the PIT otherwise, both in
+ * one-shot mode. A deadline past the reach of the hardware is split in
+ * shots, the handler only runs after the last one.
+ *
+ * While the idle task runs only the next timer of the wheel is
+ * programmed, with none pending the CPU sleeps until a device interrupt
+ * wakes a task.
+ */
+
+static struct clock_event_device _device;
+static clockevent_handler_t _handler = 0x0;
+
+static uint8_t _armed = 0;
+static uint32_t _shotUs = 0; // Length of the shot in flight
+static uint32_t _leftUs = 0; // Of the deadline, after that shot
+static uint32_t _doneUs = 0; // Shots that already fired
+static uint32_t _readUs = 0; // Handed out by clockevent_elapsed()
+
+static void _next_shot(){
+	uint32_t shot = _leftUs < _device.maxDeltaUs ? _leftUs : _device.maxDeltaUs;
+
+	_leftUs -= shot;
+
+	if(shot < _device.minDeltaUs){
+		shot = _device.minDeltaUs;
+	}
+
+	_shotUs = shot;
+	_device.set_next_event(shot);
+}
+
+static void _clockevent_irq(struct InterruptFrame* frame){
+	_device.ack();
+
+	// Stopped or reprogrammed while the interrupt was pending
+	if(!_armed){
+		return;
+	}
+
+	_doneUs += _shotUs;
+	_shotUs = 0;
+
+	if(_leftUs){
+		_next_shot();
+		return;
+	}
+
+	_armed = 0;
+
+	if(_handler){
+		_handler(frame);
+	}
+}
+
+int clockevent_init(){
+	// Periodic since the BIOS, silent until programmed again
+	pit_stop();
+
+	int res = lapic_clockevent_init(&_device);
+	if(res != SUCCESS){
+		res = pit_clockevent_init(&_device);
+		if(res != SUCCESS){
+			return res;
+		}
+	}
+
+	if(_device.vector == IRQ(0)){
+		IRQ_clear_mask(0);
+	}else{
+		IRQ_set_mask(0);
+	}
+
+	idt_register_callback(_device.vector, _clockevent_irq);
+
+	return SUCCESS;
+}
+
+const char* clockevent_name(){
+	return _device.name;
+}
+
+void clockevent_set_handler(clockevent_handler_t handler){
+	_handler = handler;
+}
+
+void clockevent_program(uint32_t us){
+	if(!_device.set_next_event){
+		return;
+	}
+
+	_armed = 1;
+	_doneUs = 0;
+	_readUs = 0;
+	_leftUs = us;
+
+	_next_shot();
+}
+
+void clockevent_stop(){
+	if(!_device.shutdown){
+		return;
+	}
+
+	_armed = 0;
+	_shotUs = 0;
+	_leftUs = 0;
+	_doneUs = 0;
+	_readUs = 0;
+
+	_device.shutdown();
+}
+
+uint32_t clockevent_elapsed(){
+	uint32_t elapsed = _doneUs;
+
+	if(_armed && _shotUs){
+		uint32_t remaining = _device.remaining();
+		elapsed += _shotUs - (remaining < _shotUs ? remaining : _shotUs);
+	}
+
+	uint32_t delta = elapsed > _readUs ? elapsed - _readUs : 0;
+	_readUs = elapsed > _readUs ? elapsed : _readUs;
+
+	return delta;
+}
@@ -0,0 +1,110 @@
+#include <arch/i386/lapic.h>
+#include <arch/i386/pit.h>
+#include <arch/i386/cpu.h>
+#include <memory/paging.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <stdint.h>
+
+#define LAPIC_REG_EOI        0x0B0
+#define LAPIC_REG_SVR        0x0F0
+#define LAPIC_REG_LVT_TIMER  0x320
+#define LAPIC_REG_TIMER_INIT 0x380
+#define LAPIC_REG_TIMER_CUR  0x390
+#define LAPIC_REG_TIMER_DIV  0x3E0
+
+#define LAPIC_BASE_ENABLE 0x800 // MSR_APIC_BASE, global enable
+#define LAPIC_SVR_ENABLE  0x100
+#define LAPIC_LVT_MASKED  0x10000
+#define LAPIC_TIMER_DIV16 0x3
+
+#define _CALIBRATE_US 10000
+
+// 16.16 fixed point, timer ticks per microsecond and back
+static uint32_t _ticksPerUs = 0;
+static uint32_t _usPerTick = 0;
+
+static inline uint32_t _read(uint32_t reg){
+	return *(volatile uint32_t*)(LAPIC_VIRT_BASE + reg);
+}
+
+static inline void _write(uint32_t reg, uint32_t value){
+	*(volatile uint32_t*)(LAPIC_VIRT_BASE + reg) = value;
+}
+
+static void _set_next_event(uint32_t us){
+	uint64_t ticks = ((uint64_t)us * _ticksPerUs) >> 16;
+
+	_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR); // One-shot
+	_write(LAPIC_REG_TIMER_INIT, ticks > 0xFFFFFFFF ? 0xFFFFFFFF : (ticks ? (uint32_t)ticks : 1));
+}
+
+static uint32_t _remaining(){
+	return ((uint64_t)_read(LAPIC_REG_TIMER_CUR) * _usPerTick) >> 16;
+}
+
+static void _shutdown(){
+	_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+	_write(LAPIC_REG_TIMER_INIT, 0);
+}
+
+static void _ack(){
+	_write(LAPIC_REG_EOI, 0);
+}
+
+// Count the timer down over a known PIT delay
+static int _calibrate(){
+	_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV16);
+	_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+	_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+
+	pit_delay_us(_CALIBRATE_US);
+
+	uint32_t ticks = 0xFFFFFFFF - _read(LAPIC_REG_TIMER_CUR);
+	_write(LAPIC_REG_TIMER_INIT, 0);
+
+	if(ticks < _CALIBRATE_US){
+		return NOT_SUPPORTED; // Under one tick per microsecond, the PIT does better
+	}
+
+	_ticksPerUs = ((ticks / _CALIBRATE_US) << 16) + (((ticks % _CALIBRATE_US) << 16) / _CALIBRATE_US);
+	_usPerTick = ((uint32_t)_CALIBRATE_US << 16) / ticks;
+
+	return SUCCESS;
+}
+
+int lapic_clockevent_init(struct clock_event_device* dev){
+	if(!cpu_has_feature_edx(CPUID_FEAT_EDX_APIC) || !cpu_has_feature_edx(CPUID_FEAT_EDX_MSR)){
+		return NOT_SUPPORTED;
+	}
+
+	uint64_t base = rdmsr(MSR_APIC_BASE);
+	if(!(base & LAPIC_BASE_ENABLE)){
+		return NOT_SUPPORTED;
+	}
+
+	// Registers are MMIO, uncached and mapped in the shared kernel tables
+	int res = paging_map((void*)LAPIC_VIRT_BASE, (void*)(uintptr_t)(base & PAGE_MASK), FPAGING_P | FPAGING_RW | FPAGING_PCD | FPAGING_PWT);
+	if(res != SUCCESS && res != ALREADY_MAPD){
+		return res;
+	}
+
+	// Software enable, LINT0 keeps delivering the 8259 interrupts
+	_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+	res = _calibrate();
+	if(res != SUCCESS){
+		return res;
+	}
+
+	dev->name = "lapic";
+	dev->vector = LAPIC_TIMER_VECTOR;
+	dev->minDeltaUs = 10;
+	dev->maxDeltaUs = 1000000;
+	dev->set_next_event = _set_next_event;
+	dev->remaining = _remaining;
+	dev->shutdown = _shutdown;
+	dev->ack = _ack;
+
+	return SUCCESS;
+}
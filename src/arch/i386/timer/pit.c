@@ -0,0 +1,95 @@
+#include <arch/i386/pit.h>
+#include <arch/i386/pic.h>
+#include <arch/i386/idt.h>
+#include <io/ports.h>
+#include <def/err.h>
+#include <stdint.h>
+
+#define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND  0x43
+#define PIT_GATE     0x61 // Channel 2 gate (bit 0) and output (bit 5)
+
+#define PIT_CMD_CH0_ONESHOT 0x30 // Channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count)
+#define PIT_CMD_CH2_ONESHOT 0xB0
+#define PIT_CMD_CH0_LATCH   0x00
+
+// Fixed point 12.20 conversions, no 64 bit division in the kernel
+#define _US_TO_COUNT(us) ((uint32_t)(((uint64_t)(us) * 1251142) >> 20))
+#define _COUNT_TO_US(c)  ((uint32_t)(((uint64_t)(c) * 878806) >> 20))
+
+static uint16_t _count = 0; // Programmed on channel 0
+
+static inline uint16_t _counts(uint32_t us){
+	uint32_t count = _US_TO_COUNT(us);
+	if(count > 0xFFFF){
+		return 0xFFFF;
+	}
+
+	return count ? count : 1;
+}
+
+// Writing the mode word alone halts a mode 0 counter until it gets a count
+void pit_stop(){
+	outb(PIT_COMMAND, PIT_CMD_CH0_ONESHOT);
+	_count = 0;
+}
+
+static void _set_next_event(uint32_t us){
+	_count = _counts(us);
+
+	outb(PIT_COMMAND, PIT_CMD_CH0_ONESHOT);
+	outb(PIT_CHANNEL0, _count & 0xFF);
+	outb(PIT_CHANNEL0, (_count >> 8) & 0xFF);
+}
+
+static uint32_t _remaining(){
+	outb(PIT_COMMAND, PIT_CMD_CH0_LATCH);
+
+	uint16_t count = inb(PIT_CHANNEL0);
+	count |= inb(PIT_CHANNEL0) << 8;
+
+	// Past the terminal count the counter wraps and keeps going
+	if(count > _count){
+		return 0;
+	}
+
+	return _COUNT_TO_US(count);
+}
+
+static void _ack(){
+	pic_send_eoi(IRQ(0));
+}
+
+int pit_clockevent_init(struct clock_event_device* dev){
+	pit_stop();
+
+	dev->name = "pit";
+	dev->vector = IRQ(0);
+	dev->minDeltaUs = 50;
+	dev->maxDeltaUs = PIT_DELAY_MAX_US;
+	dev->set_next_event = _set_next_event;
+	dev->remaining = _remaining;
+	dev->shutdown = pit_stop;
+	dev->ack = _ack;
+
+	return SUCCESS;
+}
+
+void pit_delay_us(uint32_t us){
+	uint16_t count = _counts(us > PIT_DELAY_MAX_US ? PIT_DELAY_MAX_US : us);
+
+	// Gate off and speaker off while loading
+	outb(PIT_GATE, inb(PIT_GATE) & ~0x03);
+
+	outb(PIT_COMMAND, PIT_CMD_CH2_ONESHOT);
+	outb(PIT_CHANNEL2, count & 0xFF);
+	outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+
+	// Counting starts on the rising edge of the gate
+	outb(PIT_GATE, inb(PIT_GATE) | 0x01);
+
+	while(!(inb(PIT_GATE) & 0x20));
+
+	outb(PIT_GATE, inb(PIT_GATE) & ~0x01);
+}
@@ -0,0 +1,106 @@
+#include <arch/i386/rtc.h>
+#include <io/ports.h>
+#include <def/err.h>
+#include <lib/mem.h>
+#include <stdint.h>
+
+#define CMOS_ADDRESS 0x70
+#define CMOS_DATA    0x71
+#define CMOS_NMI_OFF 0x80
+
+#define RTC_SECONDS  0x00
+#define RTC_MINUTES  0x02
+#define RTC_HOURS    0x04
+#define RTC_DAY      0x07
+#define RTC_MONTH    0x08
+#define RTC_YEAR     0x09
+#define RTC_STATUS_A 0x0A
+#define RTC_STATUS_B 0x0B
+#define RTC_CENTURY  0x32 // Not on every board, see the FADT
+
+#define RTC_A_UPDATING 0x80
+#define RTC_B_24H      0x02
+#define RTC_B_BINARY   0x04
+#define RTC_HOUR_PM    0x80
+
+static inline uint8_t _read(uint8_t reg){
+	outb(CMOS_ADDRESS, CMOS_NMI_OFF | reg);
+	return inb(CMOS_DATA);
+}
+
+static inline uint8_t _bcd(uint8_t value){
+	return (value & 0x0F) + (value >> 4) * 10;
+}
+
+static void _read_raw(uint8_t raw[7]){
+	while(_read(RTC_STATUS_A) & RTC_A_UPDATING);
+
+	raw[0] = _read(RTC_SECONDS);
+	raw[1] = _read(RTC_MINUTES);
+	raw[2] = _read(RTC_HOURS);
+	raw[3] = _read(RTC_DAY);
+	raw[4] = _read(RTC_MONTH);
+	raw[5] = _read(RTC_YEAR);
+	raw[6] = _read(RTC_CENTURY);
+}
+
+int rtc_read(struct rtc_time* time){
+	uint8_t raw[7], again[7];
+
+	// Same values twice in a row, no update ran in between
+	_read_raw(raw);
+	for(int tries = 0; tries < 8; tries++){
+		_read_raw(again);
+		if(!memcmp(raw, again, sizeof(raw))){
+			break;
+		}
+
+		memcpy(raw, again, sizeof(raw));
+	}
+
+	uint8_t status = _read(RTC_STATUS_B);
+	uint8_t pm = raw[2] & RTC_HOUR_PM;
+	raw[2] &= ~RTC_HOUR_PM;
+
+	if(!(status & RTC_B_BINARY)){
+		for(int i = 0; i < 7; i++){
+			raw[i] = _bcd(raw[i]);
+		}
+	}
+
+	if(!(status & RTC_B_24H)){
+		raw[2] = (raw[2] % 12) + (pm ? 12 : 0);
+	}
+
+	uint16_t century = raw[6] >= 19 && raw[6] <= 99 ? raw[6] : 20;
+
+	time->second = raw[0];
+	time->minute = raw[1];
+	time->hour = raw[2];
+	time->day = raw[3];
+	time->month = raw[4];
+	time->year = century * 100 + raw[5];
+
+	if(time->second > 59 || time->minute > 59 || time->hour > 23 ||
+	   !time->day || time->day > 31 || !time->month || time->month > 12 || time->year < 1970)
+	{
+		return INVALID_STATE;
+	}
+
+	return SUCCESS;
+}
+
+// Days from the civil calendar, March based so leap days come last
+uint32_t rtc_to_epoch(const struct rtc_time* time){
+	uint32_t year = time->year - (time->month <= 2);
+	uint32_t month = time->month > 2 ? time->month - 3 : time->month + 9;
+
+	uint32_t era = year / 400;
+	uint32_t yoe = year - era * 400;
+	uint32_t doy = (153 * month + 2) / 5 + time->day - 1;
+	uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	uint32_t days = era * 146097 + doe - 719468;
+
+	return days * 86400 + time->hour * 3600 + time->minute * 60 + time->second;
+}
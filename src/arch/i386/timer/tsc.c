@@ -0,0 +1,73 @@
+#include <arch/i386/tsc.h>
+#include <arch/i386/pit.h>
+#include <arch/i386/cpu.h>
+#include <def/err.h>
+#include <stdint.h>
+
+/*
+ * Time stamp counter clocksource
+ *
+ * The counter is timed over a PIT delay once at boot, cycles are then
+ * turned into nanoseconds with a 32 bit multiplier and a shift picked
+ * for the measured frequency, no division on the read path. The counter
+ * is assumed to tick at a constant rate, as it does on any CPU with an
+ * invariant TSC and under QEMU.
+ */
+
+#define _CALIBRATE_US 50000
+
+static uint32_t _mult = 0; // ns = (cycles * _mult) >> _shift
+static uint32_t _shift = 0;
+static uint32_t _khz = 0;
+static uint64_t _base = 0; // Counter at time 0
+
+// 64 by 32 bit product, the middle 64 bits of 96 after the shift
+static inline uint64_t _cycles_to_ns(uint64_t cycles){
+	uint64_t ns = ((uint64_t)(uint32_t)cycles * _mult) >> _shift;
+
+	uint32_t high = cycles >> 32;
+	if(high){
+		ns += ((uint64_t)high * _mult) << (32 - _shift);
+	}
+
+	return ns;
+}
+
+int tsc_init(){
+	if(!cpu_has_feature_edx(CPUID_FEAT_EDX_TSC)){
+		return NOT_SUPPORTED;
+	}
+
+	uint64_t start = rdtsc();
+	pit_delay_us(_CALIBRATE_US);
+	uint64_t cycles = rdtsc() - start;
+
+	if(cycles < _CALIBRATE_US || cycles > 0xFFFFFFFF){
+		return NOT_SUPPORTED;
+	}
+
+	// Biggest shift that keeps the multiplier in 32 bits
+	uint32_t shift = 32;
+	uint64_t mult = 0;
+	for(; shift; shift--){
+		mult = div_u64_rem(((uint64_t)_CALIBRATE_US * 1000) << shift, (uint32_t)cycles, 0x0);
+		if(mult <= 0xFFFFFFFF){
+			break;
+		}
+	}
+
+	_mult = (uint32_t)mult;
+	_shift = shift;
+	_khz = (uint32_t)cycles / (_CALIBRATE_US / 1000);
+	_base = start;
+
+	return SUCCESS;
+}
+
+uint64_t tsc_ns(){
+	return _mult ? _cycles_to_ns(rdtsc() - _base) : 0;
+}
+
+uint32_t tsc_khz(){
+	return _khz;
+}
@@ -13,6 +13,57 @@ bios_putchar:
 	pop bp
 	ret
 
+;Read one entry of the E820 memory map
+;
+; [bp+6]:  [Entry Buffer] (24 bytes)
+; [bp+10]: [Continuation] (ebx in/out, 0 starts the query)
+;
+; returns:
+;   eax: bytes stored in the entry, 0 on failure or at the end of the map
+global bios_e820
+
+bios_e820:
+	push bp
+	mov bp, sp
+	push ebx
+	push esi
+	push edi
+	push es
+
+	xor ax, ax
+	mov es, ax
+
+	mov di, word [bp+6]
+	mov si, word [bp+10]
+
+	mov dword [di+20], 0x1 ; Valid entry if the BIOS ignores ACPI 3.0 attributes
+
+	mov ebx, dword [si]
+	mov eax, 0xE820
+	mov ecx, 24
+	mov edx, 0x534D4150 ; 'SMAP'
+	int 0x15
+
+	jc .fail
+	cmp eax, 0x534D4150
+	jne .fail
+
+	mov si, word [bp+10]
+	mov dword [si], ebx
+	mov eax, ecx
+	jmp .out
+
+.fail:
+	xor eax, eax
+
+.out:
+	pop es
+	pop edi
+	pop esi
+	pop ebx
+	pop bp
+	ret
+
 %macro intcall 1
 	global bios_int%1h
 	bios_int%1h:
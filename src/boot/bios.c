@@ -1,4 +1,5 @@
 #include <boot/bios.h>
+#include <boot/memory.h>
 #include <stdarg.h>
 #include <stdint.h>
 
@@ -6,6 +7,8 @@ extern void bios_int10h(const struct biosreg *ireg, struct biosreg *oreg);
 
 extern void bios_putchar(char c);
 
+extern uint32_t bios_e820(struct E820Entry *entry, uint32_t *continuation);
+
 static void itoa(int value, char *result, int base)
 {
 	char *digits = "0123456789ABCDEF";
@@ -93,3 +96,34 @@ void bios_intcall(int int_no, const struct biosreg *inReg, struct biosreg *outRe
 		return;
 	}
 }
+
+/*
+ * Query the BIOS memory map (int 0x15, eax=0xE820)
+ * and save it for the protected-mode kernel
+ */
+void setup_memory_map()
+{
+	struct E820Map *map = (struct E820Map *)E820_MAP_ADDR;
+	struct E820Entry entry;
+	uint32_t continuation = 0;
+
+	map->count = 0;
+
+	do
+	{
+		if (!bios_e820(&entry, &continuation))
+			break;
+
+		if (!entry.length)
+			continue;
+
+		uint8_t *dst = (uint8_t *)&map->entries[map->count++];
+		uint8_t *src = (uint8_t *)&entry;
+
+		for (uint32_t i = 0; i < sizeof(struct E820Entry); i++)
+			dst[i] = src[i];
+	} while (continuation && map->count < E820_MAX_ENTRIES);
+
+	if (!map->count)
+		bios_printf("%s\r\n", "E820 Not Detected");
+}
@@ -1,5 +1,6 @@
 #include <boot/bios.h>
 #include <boot/video.h>
+#include <boot/memory.h>
 #include <def/compile.h>
 #include <stdint.h>
 
@@ -15,7 +16,7 @@ void main(){
 
 	// Check CPU
 
-	// Check Memory
+	setup_memory_map();
 
 	setup_video();
 
@@ -0,0 +1,235 @@
+#include <core/bench.h>
+
+#ifdef KERNEL_BENCH
+
+#include <drivers/terminal.h>
+#include <arch/i386/cpu.h>
+#include <memory/paging.h>
+#include <memory/page_alloc.h>
+#include <memory/kheap.h>
+#include <mmu.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <stdint.h>
+
+/*
+ * In-kernel micro benchmarks.
+ *
+ * Timed with the TSC and printed to the terminal at boot, before init runs.
+ * Results are cycle counts, only meaningful relative to each other.
+ */
+
+#define _SWITCH_ROUNDS 2000
+#define _KERNEL_TOUCH_PAGES 64 // Heap pages touched after every switch
+#define _USER_TOUCH_PAGES 8
+
+#define _TEARDOWN_ADDRESS PROC_MMAP_VIRTUAL_BASE
+
+#define _COMPACT_HANDLES 256 // Two block movable allocations, every other one is freed
+
+static void _touch(volatile uint8_t* base, uint32_t pages){
+	for(uint32_t i = 0; i < pages; i++){
+		(void)base[i * PAGING_PAGE_SIZE];
+	}
+}
+
+// Ping-pong between two address spaces, each side touches its own user pages and the shared kernel heap
+static uint32_t _switch_cycles(struct PagingDirectory* a, struct PagingDirectory* b, volatile uint8_t* heap){
+	uint64_t start = rdtsc();
+
+	for(uint32_t i = 0; i < _SWITCH_ROUNDS; i++){
+		mmu_page_switch(a);
+		_touch((volatile uint8_t*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES);
+		_touch(heap, _KERNEL_TOUCH_PAGES);
+
+		mmu_page_switch(b);
+		_touch((volatile uint8_t*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES);
+		_touch(heap, _KERNEL_TOUCH_PAGES);
+	}
+
+	return (uint32_t)(rdtsc() - start) / (_SWITCH_ROUNDS * 2);
+}
+
+static struct PagingDirectory* _bench_directory(){
+	struct PagingDirectory* dir = mmu_create_page();
+	if(IS_ERR(dir)){
+		return 0x0;
+	}
+
+	mmu_copy_kernel_to_directory(dir);
+
+	struct PagingDirectory* prev = _currentDirectory;
+	mmu_page_switch(dir);
+
+	int res = mmu_alloc_pages((void*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES * PAGING_PAGE_SIZE, FPAGING_P | FPAGING_RW | FPAGING_US);
+
+	mmu_page_switch(prev);
+
+	if(res != SUCCESS){
+		mmu_release_pages(dir, (void*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES * PAGING_PAGE_SIZE);
+		mmu_destroy_page(dir);
+		return 0x0;
+	}
+
+	return dir;
+}
+
+static void _bench_context_switch(){
+	struct PagingDirectory* prev = _currentDirectory;
+	struct PagingDirectory* a = _bench_directory();
+	struct PagingDirectory* b = _bench_directory();
+	uint8_t* heap = (uint8_t*)kmalloc(_KERNEL_TOUCH_PAGES * PAGING_PAGE_SIZE);
+
+	if(!a || !b || !heap){
+		terminal_write("bench: context switch setup failed\n");
+		goto out;
+	}
+
+	uint32_t cr4 = read_cr4();
+	if(!(cr4 & CR4_PGE)){
+		terminal_write("bench: no PGE, global kernel pages disabled\n");
+	}
+
+	_switch_cycles(a, b, heap); // Warm up
+
+	uint32_t global = _switch_cycles(a, b, heap);
+
+	// Without PGE every CR3 load also drops the kernel half
+	write_cr4(cr4 & ~CR4_PGE);
+	uint32_t flushed = _switch_cycles(a, b, heap);
+	write_cr4(cr4);
+
+	terminal_write(
+		"bench: context switch %d cycles (global kernel pages), %d cycles (full flush)\n",
+		global, flushed
+	);
+
+out:
+	mmu_page_switch(prev);
+
+	if(heap){
+		kfree(heap);
+	}
+
+	if(a){
+		mmu_release_pages(a, (void*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES * PAGING_PAGE_SIZE);
+		mmu_destroy_page(a);
+	}
+
+	if(b){
+		mmu_release_pages(b, (void*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES * PAGING_PAGE_SIZE);
+		mmu_destroy_page(b);
+	}
+}
+
+static int _teardown_setup(uint32_t pages){
+	int res = mmu_alloc_pages((void*)_TEARDOWN_ADDRESS, pages * PAGING_PAGE_SIZE, FPAGING_P | FPAGING_RW);
+	_touch((volatile uint8_t*)_TEARDOWN_ADDRESS, pages);
+
+	return res;
+}
+
+// Old path, paging_unmap() per page rescans the table every time
+static uint32_t _teardown_per_page(uint32_t pages){
+	if(_teardown_setup(pages) != SUCCESS){
+		return 0;
+	}
+
+	uint64_t start = rdtsc();
+
+	for(uint32_t i = 0; i < pages; i++){
+		void* virt = (void*)(_TEARDOWN_ADDRESS + (i * PAGING_PAGE_SIZE));
+		void* phys = paging_translate(virt);
+
+		paging_unmap(virt);
+		free_page(phys);
+	}
+
+	return (uint32_t)(rdtsc() - start);
+}
+
+static uint32_t _teardown_batched(uint32_t pages, uint32_t threshold){
+	if(_teardown_setup(pages) != SUCCESS){
+		return 0;
+	}
+
+	paging_set_flush_threshold(threshold);
+	uint64_t start = rdtsc();
+
+	mmu_release_pages(_currentDirectory, (void*)_TEARDOWN_ADDRESS, pages * PAGING_PAGE_SIZE);
+
+	uint32_t cycles = (uint32_t)(rdtsc() - start);
+	paging_set_flush_threshold(TLB_INVLPG_THRESHOLD);
+
+	return cycles;
+}
+
+static void _bench_teardown(){
+	static const uint32_t sizes[] = { 8, 64, 512, 2048 };
+
+	struct PagingDirectory* prev = _currentDirectory;
+	struct PagingDirectory* dir = _bench_directory();
+	if(!dir){
+		terminal_write("bench: teardown setup failed\n");
+		return;
+	}
+
+	mmu_page_switch(dir);
+
+	for(uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++){
+		uint32_t perPage = _teardown_per_page(sizes[i]);
+		uint32_t invlpg = _teardown_batched(sizes[i], 0xFFFFFFFF);
+		uint32_t reload = _teardown_batched(sizes[i], 0);
+		uint32_t batched = _teardown_batched(sizes[i], TLB_INVLPG_THRESHOLD);
+
+		terminal_write(
+			"bench: teardown %d pages, %d cycles per page unmap, %d invlpg, %d cr3, %d batched\n",
+			sizes[i], perPage, invlpg, reload, batched
+		);
+	}
+
+	mmu_page_switch(prev);
+
+	mmu_release_pages(dir, (void*)PROC_VIRTUAL_ADDRESS, _USER_TOUCH_PAGES * PAGING_PAGE_SIZE);
+	mmu_destroy_page(dir);
+}
+
+static void _bench_compaction(){
+	static struct HeapHandle* handles[_COMPACT_HANDLES];
+	struct HeapStats before, after;
+
+	uint32_t count = 0;
+	while(count < _COMPACT_HANDLES && (handles[count] = kmalloc_movable(2 * HEAP_BLOCK_SIZE))){
+		count++;
+	}
+
+	for(uint32_t i = 0; i < count; i += 2){
+		kfree_movable(handles[i]);
+		handles[i] = 0x0;
+	}
+
+	kheap_stats(&before);
+
+	uint64_t start = rdtsc();
+	uint32_t moved = kheap_compact(KHEAP_COMPACT_ALL);
+	uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+	kheap_stats(&after);
+
+	terminal_write(
+		"bench: compaction moved %d blocks in %d cycles, fragmentation %d -> %d, largest free %d -> %d blocks\n",
+		moved, cycles, before.fragmentation, after.fragmentation, before.largestFree, after.largestFree
+	);
+
+	for(uint32_t i = 1; i < count; i += 2){
+		kfree_movable(handles[i]);
+	}
+}
+
+void kernel_bench_run(){
+	_bench_context_switch();
+	_bench_teardown();
+	_bench_compaction();
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include <core/kernel.h>
 #include <core/sched.h>
+#include <core/bench.h>
+#include <core/time.h>
+#include <core/timer.h>
 #include <pid.h>
 
 #include <drivers/terminal.h>
@@ -8,6 +11,7 @@
 #include <arch/i386/idt.h>
 #include <arch/i386/pic.h>
 #include <arch/i386/tss.h>
+#include <arch/i386/clockevent.h>
 
 #include <lib/mem.h>
 #include <lib/utils.h>
@@ -15,6 +19,8 @@
 
 #include <mmu.h>
 #include <memory/kheap.h>
+#include <memory/page_alloc.h>
+#include <memory/swap.h>
 
 #include <def/config.h>
 #include <def/err.h>
@@ -82,9 +88,6 @@ static int8_t kernel_prepare_userland(){
 		return PTR_ERR(kernel_t);
 	}
 
-	kfree(kernel_t->userStack);
-	kfree(kernel_t->kernelStack);
-
 	pcb_set(kernel_t); // Set current for the exec replace
 	scheduler_add_task(kernel_t); // Prepare task inside the scheduler whem ready
 
@@ -94,12 +97,17 @@ static int8_t kernel_prepare_userland(){
 static void _load_tss(){
 	memset(&tss, 0x0, sizeof(tss));
 	tss.ss0 = KERNEL_DATA_SELECTOR;
-	tss.esp0 = PROC_KERNEL_STACK_VIRTUAL_TOP;
+	tss.esp0 = KERNEL_STACK_VIRT_TOP;
 	tss.iopb = sizeof(tss);
 
 	tss_load(0x28); // TSS segment is the 6th entry in the GDT (index 5), so selector is 0x28
 }
 
+// Stack loaded on entry from ring 3, each task has its own
+void tss_set_kernel_stack(uint32_t esp0){
+	tss.esp0 = esp0;
+}
+
 void kmain(){
 	terminal_init();
 	terminal_clear();
@@ -109,7 +117,7 @@ void kmain(){
 	gdt_structured_to_gdt(gdt, gdt_ptr, TOTAL_GDT_SEGMENTS);
 	gdt_load(gdt, sizeof(gdt) - 1);
 
-	pic_init(TIMER_FREQUENCY);
+	pic_init();
 
 	init_idt();
 
@@ -125,12 +133,32 @@ void kmain(){
 		init_kheap()
 	);
 
+	_INIT_PANIC(
+		"Initializing Page Frame Allocator",
+		"Failed to initialize the page frame allocator!",
+		page_alloc_init()
+	);
+
 	_INIT_PANIC(
 		"Initializing Memory Manager Unit",
 		"Failed to initializing Memory Manager Unit!",
 		mmu_init()
 	);
 
+	_INIT_PANIC(
+		"Initializing Clock Events",
+		"Failed to initialize the timer!",
+		clockevent_init()
+	);
+
+	// Without a TSC there is no clock_gettime and timers never expire
+	res = time_init();
+	if(IS_STAT_ERR(res)){
+		warning("No clocksource (%d)\n", res);
+	}
+
+	timer_init();
+
 	enable_interrupts();
 
 	load_drivers();
@@ -141,12 +169,22 @@ void kmain(){
 
 	syscalls_init();
 
+#ifdef KERNEL_BENCH
+	kernel_bench_run();
+#endif
+
 	_INIT_PANIC(
 		"Mounting root",
 		"Failed to mount root!",
 		vfs_mount(blkdev_find_by_name("hda"), "/", "vfat")
 	);
 
+	// Optional, without it allocations just fail once memory runs out
+	res = swap_on(SWAP_FILE_PATH);
+	if(IS_STAT_ERR(res)){
+		warning("No swap at %s (%d)\n", SWAP_FILE_PATH, res);
+	}
+
 	_INIT_PANIC(
 		"Preparing userland",
 		"failed!",
@@ -1,4 +1,5 @@
 #include <memory/paging.h>
+#include <boot/memory.h>
 #include <def/config.h>
 #include <def/compile.h>
 #include <drivers/terminal.h>
@@ -17,6 +18,8 @@ extern void kmain();
 uintptr_t allocAddr __section(".bss.boot");
 size_t allocOff __section(".bss.boot");
 
+size_t bootHeapSize __section(".bss.boot"); // Read by init_kheap()
+
 #define _MALLOC_INIT(addr) \
 	allocAddr = addr; \
 	allocOff = 0
@@ -63,7 +66,7 @@ __section(".text.boot")
 static inline void _epg(void) {
 	__asm__ __volatile__ (
 		"mov %%cr0, %%eax\n\t"
-		"or  $0x80000000, %%eax\n\t"
+		"or  $0x80010000, %%eax\n\t" // PG | WP, ring 0 writes fault on read-only pages too
 		"mov %%eax, %%cr0\n\t"
 		"jmp flush\n\t"
 		"flush:"
@@ -149,11 +152,55 @@ static void _map_kernel(struct PagingDirectory* directory){
 	);
 }
 
+// A quarter of the usable RAM goes to the kernel heap, the rest is left to the frame allocator
+__section(".text.boot")
+static size_t _heap_size(){
+	struct E820Map* map = (struct E820Map*)E820_MAP_ADDR;
+	if(!map->count){
+		return HEAP_SIZE_DEFAULT;
+	}
+
+	uint64_t usable = 0;
+	uint64_t regionEnd = 0;
+
+	for(uint32_t i = 0; i < map->count && i < E820_MAX_ENTRIES; i++){
+		struct E820Entry* entry = &map->entries[i];
+		if(entry->type != E820_USABLE){
+			continue;
+		}
+
+		usable += entry->length;
+
+		if(entry->base <= HEAP_PHYS_BASE && entry->base + entry->length > HEAP_PHYS_BASE){
+			regionEnd = entry->base + entry->length;
+		}
+	}
+
+	uint64_t size = (usable >> 2) & ~((uint64_t)MiB(1) - 1);
+
+	if(size < HEAP_SIZE_MIN){
+		size = HEAP_SIZE_MIN;
+	}
+
+	if(size > HEAP_SIZE_MAX){
+		size = HEAP_SIZE_MAX;
+	}
+
+	// The heap must not run past the RAM block it starts in
+	if(regionEnd && HEAP_PHYS_BASE + size > regionEnd){
+		size = (regionEnd - HEAP_PHYS_BASE) & ~((uint64_t)MiB(1) - 1);
+	}
+
+	return (size_t)size;
+}
+
 __section(".text.boot")
 static void _map_heap(struct PagingDirectory* directory){
 	uint8_t flags = (FPAGING_P | FPAGING_RW);
 
-	size_t heap_pages = (HEAP_SIZE_BYTES + PAGING_PAGE_SIZE - 1) / PAGING_PAGE_SIZE;
+	bootHeapSize = _heap_size();
+
+	size_t heap_pages = (bootHeapSize + PAGING_PAGE_SIZE - 1) / PAGING_PAGE_SIZE;
 
 	_map_range(
 		directory, 
@@ -163,7 +210,7 @@ static void _map_heap(struct PagingDirectory* directory){
 		flags
 	);
 
-	size_t table_size = (HEAP_SIZE_BYTES / HEAP_BLOCK_SIZE);
+	size_t table_size = (bootHeapSize / HEAP_BLOCK_SIZE);
 	size_t table_pages = (table_size + PAGING_PAGE_SIZE - 1) / PAGING_PAGE_SIZE;
 
 	_map_range(
@@ -6,7 +6,9 @@
 #include <lib/string.h>
 #include <lib/mem.h>
 #include <memory/kheap.h>
+#include <memory/arena.h>
 #include <mmu.h>
+#include <syscall.h>
 
 extern struct Process* _processes[PROC_MAX];
 
@@ -16,7 +18,7 @@ static int alloc_pid(){
             return pid + 1;
         }
     }
-    return -1;
+    return LIST_FULL;
 }
 
 struct Process* process_get(uint16_t pid) {
@@ -29,89 +31,78 @@ struct Process* process_get(uint16_t pid) {
     return _processes[pid];
 }
 
+// Copy of a NULL terminated string vector into the process arena
+static char** _copy_strings(struct arena* arena, int count, char** strings){
+    char** copy = (char**)arena_alloc(arena, sizeof(char*) * (count + 1));
+    if (!copy) {
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        copy[i] = arena_strdup(arena, strings[i]);
+        if (!copy[i]) {
+            return NULL;
+        }
+    }
+
+    copy[count] = NULL;
+    return copy;
+}
+
 struct Process* process_create(const char *name, const char *pwd, int argc, char **argv, int envc, char **envp) {
     if (!name || argc < 0 || envc < 0 || argc > PROC_ARG_MAX || envc > PROC_ARG_MAX) {
         return 0x0;
     }
 
-    struct Process *process = (struct Process*)kmalloc(sizeof(struct Process));
+    // The process, argv and envp live and die together
+    struct arena* arena = arena_create(0);
+    if (!arena) {
+        return ERR_PTR(NO_MEMORY);
+    }
+
+    struct Process *process = (struct Process*)arena_zalloc(arena, sizeof(struct Process));
     if (!process) {
+        arena_destroy(arena);
         return ERR_PTR(NO_MEMORY);
     }
 
-    process->pid = alloc_pid();
-    if (process->pid < 0) {
-        kfree(process);
-        return ERR_PTR(OUT_OF_BOUNDS);
+    process->arena = arena;
+
+    // Checked before the narrowing store, a full table must not become pid 65535
+    int pid = alloc_pid();
+    if (IS_STAT_ERR(pid)) {
+        arena_destroy(arena);
+        return ERR_PTR(pid);
     }
 
+    process->pid = pid;
+
     strncpy(process->name, name, PROC_NAME_MAX - 1);
     process->name[PROC_NAME_MAX - 1] = '\0';
 
-	process->mm = (struct mm_struct*)kzalloc(sizeof(struct mm_struct));
+	process->mm = mm_alloc();
 	if(!process->mm){
-		kfree(process);
-        return ERR_PTR(NO_MEMORY);
+		goto fail;
 	}
 
     process->mm->pageDirectory = mmu_create_page();
-    if (!process->mm->pageDirectory) {
-        kfree(process);
-		kfree(process->mm);
-        return ERR_PTR(NO_MEMORY);
+    if (IS_ERR_OR_NULL(process->mm->pageDirectory)) {
+		process->mm->pageDirectory = NULL;
+        goto fail;
     }
 
-	memset(process->fileDescriptors, 0, sizeof(process->fileDescriptors));
-
-    process->tasks = NULL;
-    process->pwd = NULL;
-
     process->argc = argc;
-    process->argv = NULL;
-
     process->envc = envc;
-    process->envp = NULL;
-
-    // Allocate and copy argv
-    if (argc > 0) {
-        process->argv = (char**)kmalloc(sizeof(char*) * (argc + 1));
-        if (!process->argv) {
-            goto fail;
-        }
 
-        for (int i = 0; i < argc; i++) {
-            process->argv[i] = strdup(argv[i]);
-            if (!process->argv[i]) {
-                for (int j = 0; j < i; j++) kfree(process->argv[j]);
-                kfree(process->argv);
-                process->argv = NULL;
-                goto fail;
-            }
-        }
-
-        process->argv[argc] = NULL;
+    if (argc > 0 && !(process->argv = _copy_strings(arena, argc, argv))) {
+        goto fail;
     }
 
-    // Allocate and copy envp
-    if (envc > 0) {
-        process->envp = (char**)kmalloc(sizeof(char*) * (envc + 1));
-        if (!process->envp) {
-            goto fail;
-        }
-
-        for (int i = 0; i < envc; i++) {
-            process->envp[i] = strdup(envp[i]);
-            if (!process->envp[i]) {
-                for (int j = 0; j < i; j++) kfree(process->envp[j]);
-                kfree(process->envp);
-                process->envp = NULL;
-                goto fail;
-            }
-        }
-        process->envp[envc] = NULL;
+    if (envc > 0 && !(process->envp = _copy_strings(arena, envc, envp))) {
+        goto fail;
     }
 
-    // Set working directory
+    // Changed by chdir, kept out of the arena
     process->pwd = pwd ? strdup(pwd) : strdup("/");
     if (!process->pwd){
         goto fail;
@@ -121,25 +112,6 @@ struct Process* process_create(const char *name, const char *pwd, int argc, char
     return process;
 
 fail:
-    if (process->argv) {
-        for (int i = 0; i < argc; i++) {
-            if (process->argv[i]) kfree(process->argv[i]);
-        }
-
-        kfree(process->argv);
-    }
-    if (process->envp) {
-        for (int i = 0; i < envc; i++) {
-            if (process->envp[i]) kfree(process->envp[i]);
-        }
-
-        kfree(process->envp);
-    }
-    
-    if (process->pwd){
-        kfree(process->pwd);
-    }
-
     if (process->mm){
 		if(process->mm->pageDirectory){
         	mmu_destroy_page(process->mm->pageDirectory);
@@ -148,7 +120,7 @@ fail:
 		kfree(process->mm);
     }
 
-    kfree(process);
+    arena_destroy(arena);
     return ERR_PTR(NO_MEMORY);
 }
 
@@ -217,12 +189,13 @@ int process_terminate(struct Process *process){
 
 	vma_destroy(process->mm);
 
-    kfree(process->argv);
-    kfree(process->envp);
-
-    kfree(process);
+    if (process->pwd) {
+        kfree(process->pwd);
+    }
 
     _processes[process->pid - 1] = NULL; // Mark the process as terminated
+
+    arena_destroy(process->arena);
     return SUCCESS;
 }
 
@@ -243,3 +216,60 @@ int process_chdir(struct Process *process, const char *path){
     process->pwd = new_pwd;
     return SUCCESS;
 }
+
+// Copy of parent whose address space shares every page copy-on-write
+struct Process* process_fork(struct Process* parent){
+    if (!parent || !parent->mm) {
+        return ERR_PTR(INVALID_ARG);
+    }
+
+    struct Process* child = process_create(parent->name, parent->pwd, parent->argc, parent->argv, parent->envc, parent->envp);
+    if (IS_ERR_OR_NULL(child)) {
+        return child ? child : ERR_PTR(INVALID_ARG);
+    }
+
+    memcpy(child->fileDescriptors, parent->fileDescriptors, sizeof(child->fileDescriptors));
+
+    mmu_copy_kernel_to_directory(child->mm->pageDirectory);
+
+    int res = vma_fork(child->mm, parent->mm);
+    if (res != SUCCESS) {
+        process_terminate(child);
+        return ERR_PTR(res);
+    }
+
+    return child;
+}
+
+SYSCALL_DEFINE0(fork){
+    struct Task* parent = pcb_current();
+    struct InterruptFrame* frame = pcb_user_frame(parent);
+
+    struct Process* child = process_fork(parent->process);
+    if (IS_ERR(child)) {
+        return PTR_ERR(child);
+    }
+
+    struct Task* task = task_new(child, (void*)frame->eip);
+    if (IS_ERR(task)) {
+        process_terminate(child);
+        return PTR_ERR(task);
+    }
+
+    // The child resumes after the int 0x80 with fork() returning 0
+    if (IS_STAT_ERR(pcb_save_from_frame(task, frame))) {
+        process_terminate(child);
+        return INVALID_ARG;
+    }
+
+    task->regs.eax = 0;
+    task->userStack = parent->userStack;
+
+    // Starts on the parent's level
+    task->priority = parent->priority;
+    task->level = parent->level;
+
+    scheduler_add_task(task);
+
+    return child->pid;
+}
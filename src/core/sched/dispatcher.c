@@ -4,6 +4,8 @@
 #include <def/status.h>
 #include <def/compile.h>
 #include <memory/paging.h>
+#include <arch/i386/tss.h>
+#include <def/config.h>
 
 static struct Task* _currentTask = 0x0;
 
@@ -58,6 +60,11 @@ int pcb_save_from_frame(struct Task* task, struct InterruptFrame* frame){
     return SUCCESS;
 }
 
+// Frame pushed when the task entered the kernel from ring 3, at the top of its kernel stack
+struct InterruptFrame* pcb_user_frame(struct Task* task){
+    return (struct InterruptFrame*)((uintptr_t)task->kernelStack + PROC_KERNEL_STACK_SIZE) - 1;
+}
+
 int pcb_switch(struct Task* task){
     if(!task || !task->process){
         return INVALID_ARG; // Task null or dont have a process associated
@@ -68,6 +75,8 @@ int pcb_switch(struct Task* task){
     }
 
     _currentTask = task;
+    tss_set_kernel_stack((uintptr_t)task->kernelStack + PROC_KERNEL_STACK_SIZE);
+
     return mmu_page_switch(task->process->mm->pageDirectory);
 }
 
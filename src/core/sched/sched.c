@@ -1,30 +1,55 @@
 #include <core/sched.h>
 #include <core/sched/task.h>
+#include <core/process.h>
 #include <core/kernel.h>
 #include <memory/kheap.h>
+#include <memory/pgtable.h>
+#include <memory/page_alloc.h>
 #include <lib/mem.h>
 #include <def/err.h>
 #include <stdint.h>
 #include <drivers/terminal.h>
 #include <io/ports.h>
-#include <arch/i386/pic.h>
-
-#define PIC_TIMER 0x20
+#include <arch/i386/clockevent.h>
+#include <core/timer.h>
 
 extern int __must_check pcb_load(struct Task* task);
 extern void pcb_set(struct Task* t);
 
-static struct TaskQueue _readyQueue;
+/*
+ * Multi-level feedback run queue
+ *
+ * Ready tasks wait in one FIFO per level, a bitmap of the non-empty
+ * levels gives the highest one with a single bsr. A task runs until its
+ * time slice is used up or a task of a higher level wakes. Using the
+ * whole slice drops the task one level (longer slices, lower priority),
+ * waking from a wait queue raises it one level up to its base priority,
+ * so disk and interactive tasks stay ahead of CPU bound ones. After
+ * SCHED_BOOST_US of busy time the demoted tasks go back to their base level.
+ *
+ * The timer is programmed in one shot for the end of the running slice
+ * or the next timer of the wheel, whichever comes first, and stopped
+ * while the idle task runs with no timer pending. A wakeup asks for an
+ * interrupt right away when the woken task should preempt.
+ */
+
+static struct TaskQueue _runQueues[SCHED_PRIORITY_LEVELS];
+static uint32_t _readyMask = 0; // Bit i set while _runQueues[i] is not empty
+static uint8_t _needResched = 0; // A task above the current one became ready
+
 static struct TaskQueue _terminateQueue;
 
-static volatile uint64_t ticks = 0;
+static uint32_t _sinceBoostUs = 0;
 uint8_t scheduling = 0; // Started?
 
 static struct Task _idleTask;
 
 static void _idle_task_entry(){
 	while (1) {
-		__asm__ volatile ("hlt");
+		// Zero frames ahead of time and compact the heap, sleep once there is nothing left to do
+		if(!pgtable_pool_refill(1) && !zero_pool_refill(1) && !kheap_compact(HEAP_COMPACT_IDLE_BLOCKS)){
+			__asm__ volatile ("hlt");
+		}
 	}
 }
 
@@ -45,43 +70,174 @@ static void init_task_idle(){
 	_idleTask.regs.cs = KERNEL_CODE_SELECTOR;
 }
 
-static struct Task* scheduler_pick_next(){
-	struct Task* t = task_dequeue(&_readyQueue);
-	if(!t) t = &_idleTask;
-	return t;
-}			
+static inline uint32_t _slice_us(int level){
+	return SCHED_SLICE_US * (1 + SCHED_PRIORITY_MAX - level);
+}
 
-static void _switch_to(struct Task* prev, struct Task* to){
-	if(prev == to){
+static void _boost();
+
+// Charge the time since the last timer read to the slice of task
+static void _account(struct Task* task){
+	uint32_t used = clockevent_elapsed();
+	if(!task || task->tid == 0){
 		return;
 	}
 
-	if(to->tid == 0 && prev->state != TASK_WAITING){
-		return;
+	task->sliceUs = used < task->sliceUs ? task->sliceUs - used : 0;
+
+	_sinceBoostUs += used;
+	if(_sinceBoostUs >= SCHED_BOOST_US){
+		_sinceBoostUs = 0;
+		_boost();
+	}
+}
+
+// Next interrupt at the end of the slice of task or for the timer wheel
+static void _program(struct Task* task){
+	uint32_t us = timer_next_us();
+	if(task && task->tid != 0 && task->sliceUs < us){
+		us = task->sliceUs;
+	}
+
+	if(us == TIMER_NONE){
+		clockevent_stop();
+	}else{
+		clockevent_program(us);
+	}
+}
+
+// Timer interrupt as soon as possible, the handler switches
+static void _kick(){
+	_account(pcb_current());
+	_needResched = 1;
+	clockevent_program(0);
+}
+
+static inline int _highest_level(){
+	uint32_t level;
+	__asm__ volatile("bsr %1, %0" : "=r"(level) : "rm"(_readyMask));
+	return level;
+}
+
+static void _enqueue(struct Task* task){
+	if(!task->sliceUs){
+		task->sliceUs = _slice_us(task->level);
 	}
 
+	task_enqueue(&_runQueues[task->level], task);
+	_readyMask |= 1u << task->level;
+
+	struct Task* current = pcb_current();
+	if(scheduling && current && current != task && (current->tid == 0 || task->level > current->level)){
+		_kick();
+	}
+}
+
+static void _dequeue(struct Task* task){
+	struct TaskQueue* queue = &_runQueues[task->level];
+
+	task_queue_remove(queue, task);
+	if(!queue->count){
+		_readyMask &= ~(1u << task->level);
+	}
+}
+
+static struct Task* scheduler_pick_next(){
+	if(!_readyMask){
+		return &_idleTask;
+	}
+
+	int level = _highest_level();
+	struct Task* t = task_dequeue(&_runQueues[level]);
+
+	if(!_runQueues[level].count){
+		_readyMask &= ~(1u << level);
+	}
+
+	return t;
+}
+
+// Queue prev again if it can still run and switch to the best ready task
+static void _switch_from(struct Task* prev){
+	_account(prev);
+
 	if(prev && prev->tid != 0){
 		if(prev->state == TASK_RUNNING || prev->state == TASK_READY){
 			prev->state = TASK_READY;
-			task_enqueue(&_readyQueue, prev);
+			_enqueue(prev);
 		}else if(prev->state == TASK_FINISHED){
 			task_enqueue(&_terminateQueue, prev);
 		}else if(prev->state != TASK_WAITING){
-			panic("_switch_to(): Unknown task state!");
+			panic("_switch_from(): Unknown task state!");
 		}
 	}
 
+	_needResched = 0;
+
+	struct Task* to = scheduler_pick_next();
 	to->state = TASK_RUNNING;
+
+	_program(to);
+
+	if(prev == to){
+		return;
+	}
+
 	if(IS_STAT_ERR(pcb_load(to))){
 		panic("pcb_load(): Invalid task!");
 	}
 }
 
-static void _schedule_iqr_PIT_handler(struct InterruptFrame* frame){
+// Demoted tasks back to their base level, starved ones get to run again
+static void _boost(){
+	for(int level = 0; level < SCHED_PRIORITY_MAX; level++){
+		struct Task* task = _runQueues[level].head;
+
+		while(task){
+			struct Task* next = task->snext;
+
+			if(task->level < task->priority){
+				_dequeue(task);
+				task->level = task->priority;
+				task->sliceUs = 0;
+				_enqueue(task);
+			}
+
+			task = next;
+		}
+	}
+
+	struct Task* current = pcb_current();
+	if(current && current->tid != 0){
+		current->level = current->priority;
+	}
+}
+
+// Terminate the processes of finished tasks, except the one whose stack we are running on
+static void _reap_finished(){
+	struct Task* current = pcb_current();
+	struct Task* task = _terminateQueue.head;
+
+	while(task){
+		struct Process* process = task->process;
+
+		if(process && (!current || current->process != process)){
+			process_terminate(process);
+			task = _terminateQueue.head;
+			continue;
+		}
+
+		task = task->snext;
+	}
+}
+
+static void _schedule_timer_handler(struct InterruptFrame* frame){
 	if(!scheduling){
 		return;
 	}
 
+	_reap_finished();
+
 	struct Task* prev = pcb_current();
 
 	uint32_t idle_task_esp = prev->regs.esp;
@@ -94,10 +250,24 @@ static void _schedule_iqr_PIT_handler(struct InterruptFrame* frame){
 		prev->regs.esp = idle_task_esp;
 	}
 
-	pic_send_eoi(PIC_TIMER);
-	struct Task* next = scheduler_pick_next();
+	// Expired callbacks may wake tasks, before deciding who runs
+	timer_run();
 
-	_switch_to(prev, next);
+	_account(prev);
+
+	if(prev->tid != 0){
+		if(!prev->sliceUs){
+			// Ran the whole slice, CPU bound
+			if(prev->level > 0){
+				prev->level--;
+			}
+		}else if(!_needResched){
+			_program(prev); // Early interrupt, the slice goes on
+			return;
+		}
+	}
+
+	_switch_from(prev);
 }
 
 void schedule(){
@@ -111,9 +281,17 @@ void schedule(){
 		return;
 	}
 
-	struct Task* next = scheduler_pick_next();
+	_switch_from(prev);
+}
+
+void scheduler_exit_current(){
+	struct Task* task = pcb_current();
+	task->state = TASK_FINISHED;
+
+	_switch_from(task);
 
-	_switch_to(prev, next);
+	panic("scheduler_exit_current(): Returned to a finished task!");
+	__builtin_unreachable();
 }
 
 void scheduler_start(){
@@ -122,9 +300,16 @@ void scheduler_start(){
 	}
 
 	pcb_set(&_idleTask);
-	idt_register_callback(PIC_TIMER, _schedule_iqr_PIT_handler);
-	ticks = 0;
+	clockevent_set_handler(_schedule_timer_handler);
+	_sinceBoostUs = 0;
 	scheduling = 1;
+
+	// Idle first, the clock still has to come for timers added before the start
+	if(_readyMask){
+		clockevent_program(0);
+	}else{
+		_program(&_idleTask);
+	}
 }
 
 void scheduler_init(){
@@ -132,30 +317,61 @@ void scheduler_init(){
 
 	init_task_idle();
 
-	memset(&_readyQueue, 0x0, sizeof(struct TaskQueue));
+	memset(_runQueues, 0x0, sizeof(_runQueues));
 	memset(&_terminateQueue, 0x0, sizeof(struct TaskQueue));
 
+	_readyMask = 0;
+	_needResched = 0;
+
 	scheduling = 0;
 }
 
 void scheduler_add_task(struct Task* task){
 	task->state = TASK_READY;
-	task_enqueue(&_readyQueue, task);
+	_enqueue(task);
+}
+
+// Blocked before the end of its slice, one level up for a fresh one
+void scheduler_wake_task(struct Task* task){
+	if(!task || task->state != TASK_WAITING){
+		return;
+	}
+
+	// Woken before it got to switch out, it just goes on
+	if(task == pcb_current()){
+		task->state = TASK_RUNNING;
+		return;
+	}
+
+	if(task->level < task->priority){
+		task->level++;
+	}
+
+	task->sliceUs = 0;
+	scheduler_add_task(task);
+}
+
+// A timer was added, the next interrupt may have to come sooner
+void scheduler_timers_changed(){
+	if(!scheduling){
+		return;
+	}
+
+	struct Task* current = pcb_current();
+	_account(current);
+	_program(current);
 }
 
 void scheduler_remove_task(struct Task* task){
-	struct TaskQueue* queue;
 	switch (task->state)
 	{
 	case TASK_READY:
-		queue = &_readyQueue;
+		_dequeue(task);
 		break;
 	case TASK_FINISHED:
-		queue = &_terminateQueue;
+		task_queue_remove(&_terminateQueue, task);
 		break;
 	default:
 		return;
 	}
-
-	task_queue_remove(queue, task);
 }
@@ -1,6 +1,8 @@
 #include <core/sched/task.h>
 #include <core/process.h>
+#include <core/sched.h>
 #include <memory/kheap.h>
+#include <memory/slab.h>
 #include <lib/mem.h>
 #include <def/config.h>
 #include <def/err.h>
@@ -8,6 +10,8 @@
 
 extern uint16_t next_tid;
 
+static struct kmem_cache _taskCache = KMEM_CACHE_INIT("task", sizeof(struct Task));
+
 static inline int alloc_tid() {
     return next_tid++; // Increment and return the next TID
 }
@@ -17,34 +21,28 @@ struct Task* task_new(struct Process* proc, void* entry_point){
         return ERR_PTR(INVALID_ARG);
     }
 
-    struct Task* task = (struct Task*)kmalloc(sizeof(struct Task));
+    struct Task* task = (struct Task*)kmem_cache_alloc(&_taskCache);
     if (!task) {
         return ERR_PTR(NO_MEMORY);
     }
 
-    void* userStack = kmalloc(PROC_USER_STACK_SIZE);
-    if (!userStack) {
-        kfree(task);
-        return ERR_PTR(NO_MEMORY);
-    }
-
     void* kernelStack = kmalloc(PROC_KERNEL_STACK_SIZE);
     if (!kernelStack) {
-        kfree(userStack);
-        kfree(task);
+        kmem_cache_free(&_taskCache, task);
         return ERR_PTR(NO_MEMORY);
     }
 
     memset(task, 0, sizeof(struct Task));
-    memset(userStack, 0, PROC_USER_STACK_SIZE);
-    memset(kernelStack, 0, PROC_KERNEL_STACK_SIZE);
 
+    // The user stack is a region of the process address space, set up by exec
     task->tid = alloc_tid();
     task->process = proc;
-    task->userStack = userStack;
+    task->userStack = NULL;
     task->kernelStack = kernelStack;
     task->state = TASK_NEW;
-    task->priority = 0; // Default priority
+    task->priority = SCHED_PRIORITY_DEFAULT;
+    task->level = SCHED_PRIORITY_DEFAULT;
+    task->sliceUs = 0; // Filled when queued
     task->next = NULL;
     task->prev = NULL;
 
@@ -69,17 +67,37 @@ void task_dispose(struct Task* task){
         process_remove_task(proc, task);
     }
 
-    if (task->userStack) {
-        kfree(task->userStack);
+    next_tid--;
+
+    kfree(task->kernelStack);
+
+    kmem_cache_free(&_taskCache, task);
+}
+
+void task_set_priority(struct Task* task, int priority){
+    if (!task) {
+        return;
+    }
+
+    if (priority < 0) {
+        priority = 0;
+    } else if (priority > SCHED_PRIORITY_MAX) {
+        priority = SCHED_PRIORITY_MAX;
     }
 
-    if (task->kernelStack) {
-        kfree(task->kernelStack);
+    // Move it to the queue of its new level
+    uint8_t queued = task->state == TASK_READY;
+    if (queued) {
+        scheduler_remove_task(task);
     }
 
-    next_tid--;
+    task->priority = priority;
+    task->level = priority;
+    task->sliceUs = 0;
 
-    kfree(task);
+    if (queued) {
+        scheduler_add_task(task);
+    }
 }
 
 void task_set_state(struct Task* task, enum TaskState state){
@@ -138,6 +156,11 @@ void task_queue_remove(struct TaskQueue* queue, struct Task* task){
         return;
     }
 
+    // Not queued here
+    if (!task->sprev && queue->head != task) {
+        return;
+    }
+
     if (task->sprev) {
         task->sprev->snext = task->snext;
     } else {
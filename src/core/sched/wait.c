@@ -0,0 +1,154 @@
+#include <core/sched/wait.h>
+#include <core/sched.h>
+#include <core/timer.h>
+#include <lib/list.h>
+#include <def/err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Wait queues and completions
+ *
+ * A blocked task is off the run queues and costs nothing until an event
+ * or its timeout wakes it. The entry lives on the stack of the waiting
+ * task and is unlinked by whoever wakes it, so a task is woken once
+ * per event and wake_up_one() never spends a wakeup on a task that is
+ * already runnable.
+ *
+ * The kernel runs with interrupts off, nothing can wake the task
+ * between prepare_to_wait() and the check of the condition.
+ *
+ * Before scheduler_start() and in the idle task there is nobody to
+ * switch to, wait_event_timeout() spins on the condition instead like
+ * timer_sleep_ns() does and the interrupts still come in.
+ */
+
+#define _COMPLETE_ALL 0xFFFFFFFF
+
+static void _unlink(struct wait_queue_entry* wait){
+	if(wait->head){
+		list_remove(&wait->entry);
+		wait->head = 0x0;
+	}
+}
+
+static void _wait_timeout(struct timer_list* timer){
+	struct wait_queue_entry* wait = (struct wait_queue_entry*)timer->data;
+
+	_unlink(wait);
+	scheduler_wake_task(wait->task);
+}
+
+void wait_queue_init(struct wait_queue_head* head){
+	INIT_LIST_HEAD(&head->waiters);
+}
+
+void wait_entry_init(struct wait_queue_entry* wait, uint64_t timeoutNs){
+	wait->task = pcb_current();
+	wait->head = 0x0;
+	INIT_LIST_HEAD(&wait->entry);
+
+	timer_setup(&wait->timeout, _wait_timeout, wait);
+
+	wait->timed = timeoutNs != WAIT_FOREVER;
+	if(wait->timed){
+		timer_add_ns(&wait->timeout, timeoutNs);
+	}
+}
+
+void prepare_to_wait(struct wait_queue_head* head, struct wait_queue_entry* wait){
+	if(!wait->head){
+		list_add(&wait->entry, head->waiters.prev);
+		wait->head = head;
+	}
+
+	if(wait->task){
+		wait->task->state = TASK_WAITING;
+	}
+}
+
+void finish_wait(struct wait_queue_entry* wait){
+	_unlink(wait);
+	timer_cancel(&wait->timeout);
+
+	if(wait->task && wait->task->state == TASK_WAITING){
+		wait->task->state = TASK_RUNNING;
+	}
+}
+
+uint8_t wait_can_sleep(){
+	struct Task* task = pcb_current();
+	return scheduling && task && task->tid;
+}
+
+int wait_schedule(struct wait_queue_entry* wait){
+	struct Task* task = wait->task;
+	if(!scheduling || !task || !task->tid){
+		return INVALID_STATE;
+	}
+
+	if(wait->timed && !timer_pending(&wait->timeout)){
+		return TIMEOUT;
+	}
+
+	schedule();
+
+	if(wait->timed && !timer_pending(&wait->timeout)){
+		return TIMEOUT;
+	}
+
+	return SUCCESS;
+}
+
+uint8_t wake_up_one(struct wait_queue_head* head){
+	if(head->waiters.next == &head->waiters){
+		return 0;
+	}
+
+	struct wait_queue_entry* wait = list_entry(head->waiters.next, struct wait_queue_entry, entry);
+
+	_unlink(wait);
+	scheduler_wake_task(wait->task);
+
+	return 1;
+}
+
+void wake_up_all(struct wait_queue_head* head){
+	while(wake_up_one(head));
+}
+
+void init_completion(struct completion* done){
+	done->done = 0;
+	wait_queue_init(&done->wait);
+}
+
+void reinit_completion(struct completion* done){
+	done->done = 0;
+}
+
+void complete(struct completion* done){
+	if(done->done != _COMPLETE_ALL){
+		done->done++;
+	}
+
+	wake_up_one(&done->wait);
+}
+
+void complete_all(struct completion* done){
+	done->done = _COMPLETE_ALL;
+	wake_up_all(&done->wait);
+}
+
+int wait_for_completion_timeout(struct completion* done, uint64_t ns){
+	int res = wait_event_timeout(&done->wait, done->done, ns);
+
+	if(res == SUCCESS && done->done != _COMPLETE_ALL){
+		done->done--;
+	}
+
+	return res;
+}
+
+int wait_for_completion(struct completion* done){
+	return wait_for_completion_timeout(done, WAIT_FOREVER);
+}
@@ -0,0 +1,103 @@
+#include <core/time.h>
+#include <core/timer.h>
+#include <core/kernel.h>
+#include <arch/i386/tsc.h>
+#include <arch/i386/rtc.h>
+#include <arch/i386/cpu.h>
+#include <def/err.h>
+#include <uaccess.h>
+#include <syscall.h>
+#include <stdint.h>
+
+/*
+ * Kernel time
+ *
+ * Monotonic time is read from the TSC, wall time is the CMOS clock
+ * read once at boot plus the monotonic time since then. Both are
+ * nanoseconds in 64 bits, only the split into seconds divides.
+ */
+
+static uint8_t _ready = 0;
+static uint64_t _bootEpochNs = 0;
+
+int time_init(){
+	int res = tsc_init();
+	if(res != SUCCESS){
+		return res;
+	}
+
+	_ready = 1;
+
+	struct rtc_time rtc;
+	res = rtc_read(&rtc);
+	if(res != SUCCESS){
+		warning("Bad CMOS clock (%d), wall time starts at the epoch\n", res);
+		return SUCCESS;
+	}
+
+	_bootEpochNs = (uint64_t)rtc_to_epoch(&rtc) * NSEC_PER_SEC;
+
+	return SUCCESS;
+}
+
+uint8_t time_has_clocksource(){
+	return _ready;
+}
+
+uint64_t time_monotonic_ns(){
+	return tsc_ns();
+}
+
+uint64_t time_realtime_ns(){
+	return _bootEpochNs + tsc_ns();
+}
+
+void time_ns_to_timespec(uint64_t ns, struct timespec* ts){
+	uint32_t nsec;
+	ts->tv_sec = (int32_t)div_u64_rem(ns, NSEC_PER_SEC, &nsec);
+	ts->tv_nsec = (int32_t)nsec;
+}
+
+SYSCALL_DEFINE2(clock_gettime, int, clock, struct timespec*, tp){
+	if(!_ready){
+		return NOT_SUPPORTED;
+	}
+
+	uint64_t ns;
+	switch(clock){
+		case CLOCK_REALTIME:
+			ns = time_realtime_ns();
+			break;
+		case CLOCK_MONOTONIC:
+			ns = time_monotonic_ns();
+			break;
+		default:
+			return INVALID_ARG;
+	}
+
+	struct timespec ts;
+	time_ns_to_timespec(ns, &ts);
+
+	return copy_to_user(&ts, tp, sizeof(ts));
+}
+
+// On the timer wheel, there are no signals to cut it short
+SYSCALL_DEFINE2(nanosleep, const struct timespec*, req, struct timespec*, rem){
+	if(!_ready){
+		return NOT_SUPPORTED;
+	}
+
+	struct timespec ts;
+	int res = copy_from_user(&ts, req, sizeof(ts));
+	if(res != SUCCESS){
+		return res;
+	}
+
+	if(ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= (int32_t)NSEC_PER_SEC){
+		return INVALID_ARG;
+	}
+
+	timer_sleep_ns((uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+
+	return SUCCESS;
+}
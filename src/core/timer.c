@@ -0,0 +1,317 @@
+#include <core/timer.h>
+#include <core/time.h>
+#include <core/sched.h>
+#include <lib/list.h>
+#include <arch/i386/cpu.h>
+#include <def/config.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel
+ *
+ * A pending timer hangs in one of the 256 root slots, one per tick, or
+ * in one of the 64 slots of an outer level, each outer level covers 64
+ * times the span of the level below. Adding and cancelling only link
+ * and unlink a list entry. Every time the root level wraps around, the
+ * next slot of the level above is spread over the levels below
+ * (cascade), a timer moves at most once per level whatever the number
+ * of pending ones.
+ *
+ * The wheel is advanced from the clock interrupt up to the monotonic
+ * time, stretches without root timers are skipped. Expired timers are
+ * taken off the wheel first and their callbacks run once it is
+ * consistent again, they may add and cancel timers and wake tasks but
+ * must not sleep. The scheduler programs the clock event for the end
+ * of the slice or timer_next_us(), whichever comes first.
+ */
+
+#define _ROOT_BITS 8
+#define _LEVEL_BITS 6
+#define _OUTER_LEVELS 3
+
+#define _ROOT_SIZE (1 << _ROOT_BITS)
+#define _LEVEL_SIZE (1 << _LEVEL_BITS)
+#define _ROOT_MASK (_ROOT_SIZE - 1)
+#define _LEVEL_MASK (_LEVEL_SIZE - 1)
+
+#define _SLOTS (_ROOT_SIZE + _OUTER_LEVELS * _LEVEL_SIZE)
+#define _SPAN ((uint64_t)1 << (_ROOT_BITS + _OUTER_LEVELS * _LEVEL_BITS)) // 2^26 ticks, about 19 hours
+
+#define _EXPIRED 0xFFFF // Slot of a timer waiting for its callback
+
+static struct list_head _wheel[_SLOTS];
+static uint32_t _occupied[_SLOTS / 32]; // Bit set while the slot is not empty
+static uint32_t _pending = 0;
+static uint32_t _rootPending = 0;
+
+static uint64_t _base = 0; // Next tick to run
+static struct list_head _expired;
+
+static inline uint64_t _now(){
+	return time_monotonic_ns() >> TIMER_TICK_SHIFT;
+}
+
+static inline uint32_t _level_shift(int level){
+	return _ROOT_BITS + (level - 1) * _LEVEL_BITS;
+}
+
+static void _link(struct timer_list* timer){
+	uint64_t expires = timer->expires;
+	uint32_t slot;
+
+	if(expires < _base){
+		slot = _base & _ROOT_MASK; // Late, runs with the next tick
+	}else{
+		uint64_t delta = expires - _base;
+
+		// Past the outer level, cascaded down and put back there until it is in reach
+		if(delta >= _SPAN){
+			delta = _SPAN - 1;
+			expires = _base + delta;
+		}
+
+		if(delta < _ROOT_SIZE){
+			slot = expires & _ROOT_MASK;
+		}else{
+			int level = 1;
+			while(delta >> (_level_shift(level) + _LEVEL_BITS)){
+				level++;
+			}
+
+			slot = _ROOT_SIZE + (level - 1) * _LEVEL_SIZE + ((expires >> _level_shift(level)) & _LEVEL_MASK);
+		}
+	}
+
+	timer->slot = slot;
+	list_add(&timer->entry, _wheel[slot].prev);
+
+	_occupied[slot >> 5] |= 1u << (slot & 31);
+	_pending++;
+	if(slot < _ROOT_SIZE){
+		_rootPending++;
+	}
+}
+
+static void _unlink(struct timer_list* timer){
+	uint32_t slot = timer->slot;
+	list_remove(&timer->entry);
+
+	if(slot == _EXPIRED){
+		return;
+	}
+
+	_pending--;
+	if(slot < _ROOT_SIZE){
+		_rootPending--;
+	}
+
+	if(_wheel[slot].next == &_wheel[slot]){
+		_occupied[slot >> 5] &= ~(1u << (slot & 31));
+	}
+}
+
+// Timers of slot into the levels below, 0 once the level wrapped too
+static uint32_t _cascade(int level){
+	uint32_t index = (_base >> _level_shift(level)) & _LEVEL_MASK;
+	struct list_head* head = &_wheel[_ROOT_SIZE + (level - 1) * _LEVEL_SIZE + index];
+
+	while(head->next != head){
+		struct timer_list* timer = list_entry(head->next, struct timer_list, entry);
+		_unlink(timer);
+		_link(timer);
+	}
+
+	return index;
+}
+
+static void _expire_slot(uint32_t slot){
+	struct list_head* head = &_wheel[slot];
+
+	while(head->next != head){
+		struct timer_list* timer = list_entry(head->next, struct timer_list, entry);
+		_unlink(timer);
+
+		timer->slot = _EXPIRED;
+		list_add(&timer->entry, _expired.prev);
+	}
+}
+
+// Distance from index to the first slot in use of the ring of size slots at first
+static int32_t _next_slot(uint32_t first, uint32_t size, uint32_t index){
+	uint32_t words = size / 32;
+	uint32_t start = index >> 5;
+
+	for(uint32_t i = 0; i <= words; i++){
+		uint32_t word = (start + i) & (words - 1);
+		uint32_t bits = _occupied[(first >> 5) + word];
+
+		if(i == 0){
+			bits &= ~0u << (index & 31);
+		}else if(i == words){
+			bits &= (1u << (index & 31)) - 1;
+		}
+
+		if(bits){
+			return ((word << 5) + __builtin_ctz(bits) - index) & (size - 1);
+		}
+	}
+
+	return -1;
+}
+
+// Tick of the next expiry or cascade, the clock interrupt is not needed before
+static uint64_t _next_event(){
+	uint64_t next = (uint64_t)-1;
+
+	if(_rootPending){
+		next = _base + _next_slot(0, _ROOT_SIZE, _base & _ROOT_MASK);
+	}
+
+	// A slot of an outer level is cascaded when the base crosses its multiple of the level span
+	for(int level = 1; level <= _OUTER_LEVELS; level++){
+		uint32_t shift = _level_shift(level);
+		uint64_t first = (_base + ((uint64_t)1 << shift) - 1) >> shift;
+
+		int32_t distance = _next_slot(_ROOT_SIZE + (level - 1) * _LEVEL_SIZE, _LEVEL_SIZE, first & _LEVEL_MASK);
+		if(distance < 0){
+			continue;
+		}
+
+		uint64_t tick = (first + distance) << shift;
+		if(tick < next){
+			next = tick;
+		}
+	}
+
+	return next;
+}
+
+void timer_init(){
+	for(int i = 0; i < _SLOTS; i++){
+		INIT_LIST_HEAD(&_wheel[i]);
+	}
+
+	INIT_LIST_HEAD(&_expired);
+
+	for(int i = 0; i < _SLOTS / 32; i++){
+		_occupied[i] = 0;
+	}
+
+	_pending = 0;
+	_rootPending = 0;
+	_base = _now();
+}
+
+void timer_setup(struct timer_list* timer, timer_fn_t function, void* data){
+	INIT_LIST_HEAD(&timer->entry);
+	timer->expires = 0;
+	timer->function = function;
+	timer->data = data;
+	timer->slot = _EXPIRED;
+}
+
+void timer_add(struct timer_list* timer, uint64_t expires){
+	if(timer_pending(timer)){
+		_unlink(timer);
+	}
+
+	// Nothing to run since the last interrupt, catch up for free
+	if(!_pending){
+		uint64_t now = _now();
+		if(now > _base){
+			_base = now;
+		}
+	}
+
+	timer->expires = expires;
+	_link(timer);
+
+	scheduler_timers_changed();
+}
+
+void timer_add_ns(struct timer_list* timer, uint64_t ns){
+	uint64_t deadline = time_monotonic_ns() + ns;
+	timer_add(timer, (deadline + (1u << TIMER_TICK_SHIFT) - 1) >> TIMER_TICK_SHIFT);
+}
+
+uint8_t timer_cancel(struct timer_list* timer){
+	if(!timer_pending(timer)){
+		return 0;
+	}
+
+	_unlink(timer);
+	return 1;
+}
+
+static void _wake_sleeper(struct timer_list* timer){
+	scheduler_wake_task((struct Task*)timer->data);
+}
+
+void timer_sleep_ns(uint64_t ns){
+	struct Task* task = pcb_current();
+
+	// Nobody to switch to, spin on the clock
+	if(!scheduling || !task || !task->tid){
+		uint64_t deadline = time_monotonic_ns() + ns;
+		while(time_monotonic_ns() < deadline);
+		return;
+	}
+
+	struct timer_list timer;
+	timer_setup(&timer, _wake_sleeper, task);
+	timer_add_ns(&timer, ns);
+
+	while(timer_pending(&timer)){
+		task->state = TASK_WAITING;
+		schedule();
+	}
+}
+
+void timer_run(){
+	uint64_t now = _now();
+
+	while(_base <= now){
+		if(!_pending){
+			_base = now + 1;
+			break;
+		}
+
+		uint32_t index = _base & _ROOT_MASK;
+
+		// Straight to the next cascade
+		if(!_rootPending && index){
+			_base = (_base | _ROOT_MASK) + 1;
+			continue;
+		}
+
+		if(!index){
+			for(int level = 1; level <= _OUTER_LEVELS && !_cascade(level); level++);
+		}
+
+		_expire_slot(index);
+		_base++;
+	}
+
+	while(_expired.next != &_expired){
+		struct timer_list* timer = list_entry(_expired.next, struct timer_list, entry);
+		list_remove(&timer->entry);
+
+		timer->function(timer);
+	}
+}
+
+uint32_t timer_next_us(){
+	if(!_pending){
+		return TIMER_NONE;
+	}
+
+	uint64_t at = _next_event() << TIMER_TICK_SHIFT;
+	uint64_t now = time_monotonic_ns();
+	if(at <= now){
+		return 0;
+	}
+
+	uint64_t us = div_u64_rem(at - now + 999, 1000, 0x0);
+	return us < TIMER_NONE ? (uint32_t)us : TIMER_NONE - 1;
+}
@@ -105,6 +105,7 @@ static void _ata_probe_all() {
 			struct ATADevice* atadev = &ch->devices[drive];
 			atadev->channel = ch;
 			atadev->drive = drive;
+			init_completion(&atadev->irqDone);
 
 			uint16_t buffer[WORDS_PER_SECTOR];
 			if (ata_identify(atadev, buffer) == SUCCESS) {
@@ -148,9 +149,10 @@ static void _ata_probe_all() {
 	}
 }
 
-int ata_identify(struct ATADevice* atadev, uint16_t* buffer) {
+static int _ata_identify(struct ATADevice* atadev, uint16_t* buffer) {
 	struct ATAChannel* channel = atadev->channel;
 	channel->active = atadev;
+	reinit_completion(&atadev->irqDone);
 
 	outb_p(ATA_IO(channel, ATA_REG_HDDEVSEL), 0xA0 | (atadev->drive << 4)); // Drive/head register
 	outb_p(ATA_IO(channel, ATA_REG_SECCOUNT0), 0);
@@ -159,7 +161,7 @@ int ata_identify(struct ATADevice* atadev, uint16_t* buffer) {
 	outb_p(ATA_IO(channel, ATA_REG_LBA2), 0);
 	outb_p(ATA_IO(channel, ATA_REG_COMMAND), ATA_CMD_IDENTIFY);
 
-	uint8_t status;
+	int status;
 	if(IS_STAT_ERR(status = ata_wait_irq(atadev))){
 		return status;
 	}
@@ -173,8 +175,18 @@ int ata_identify(struct ATADevice* atadev, uint16_t* buffer) {
     return SUCCESS;
 }
 
+int ata_identify(struct ATADevice* atadev, uint16_t* buffer) {
+	ata_channel_lock(atadev->channel);
+	int res = _ata_identify(atadev, buffer);
+	ata_channel_unlock(atadev->channel);
+
+	return res;
+}
+
 void ata_init(){
 	memset(&_ata_primary, 0x0, sizeof(struct ATAChannel));
 	memset(&_ata_secondary, 0x0, sizeof(struct ATAChannel));
+	wait_queue_init(&_ata_primary.idle);
+	wait_queue_init(&_ata_secondary.idle);
 	_ata_probe_all();
 }
@@ -3,7 +3,8 @@
 
 #include <stdint.h>
 
-#define TRIES 100000
+#define TRIES 100000 // Polling without a clocksource
+#define ATA_TIMEOUT_US 5000000
 
 #define SECTOR_SIZE 512
 #define WORDS_PER_SECTOR 256
@@ -84,6 +85,16 @@ static inline uint8_t ata_status(struct ATADevice* atadev) {
 	return inb_p(ATA_IO(atadev->channel, ATA_REG_STATUS));
 }
 
+static inline void ata_channel_lock(struct ATAChannel* ch) {
+	(void)wait_event(&ch->idle, !ch->busy);
+	ch->busy = 1;
+}
+
+static inline void ata_channel_unlock(struct ATAChannel* ch) {
+	ch->busy = 0;
+	wake_up_one(&ch->idle);
+}
+
 int ata_read(struct file *file, void *buffer, uint32_t count);
 int ata_write(struct file *file, const void *buffer, uint32_t count);
 int ata_lseek(struct file *file, int offset, int whence);
@@ -6,17 +6,19 @@
 
 #include "ata_internal.h"
 
-int ata_flush(struct ATADevice* atadev) {
+static int _ata_flush(struct ATADevice* atadev) {
 	struct ATAChannel* ch = atadev->channel;
 	ch->active = atadev;
-	atadev->irqTriggered = 0;
+	reinit_completion(&atadev->irqDone);
 
 	outb_p(ATA_IO(ch, ATA_REG_HDDEVSEL), 0xE0 | (atadev->drive << 4));
 	outb_p(ATA_IO(ch, ATA_REG_COMMAND), atadev->info.isLBA48 ? 
 		ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH
 	);
 
-	ata_wait_irq(atadev);
+	int res = ata_wait_irq(atadev);
+	if (IS_STAT_ERR(res))
+		return res;
 
 	if (ata_status(atadev) & ATA_SR_ERR)
 		return -inb_p(ATA_IO(ch, ATA_REG_ERROR));
@@ -24,6 +26,14 @@ int ata_flush(struct ATADevice* atadev) {
 	return SUCCESS;
 }
 
+int ata_flush(struct ATADevice* atadev) {
+	ata_channel_lock(atadev->channel);
+	int res = _ata_flush(atadev);
+	ata_channel_unlock(atadev->channel);
+
+	return res;
+}
+
 static int _pio_28_io_cmd(struct ATADevice* atadev, uint8_t cmd, uint32_t lba, uint8_t totalSectors){
 	if(cmd != ATA_CMD_READ_PIO && cmd != ATA_CMD_WRITE_PIO){
 		return INVALID_ARG;
@@ -72,7 +82,10 @@ static int _pio_read(struct ATADevice* atadev, void* buffer, int totalSectors){
 	struct ATAChannel* ch = atadev->channel;
 
 	for(int sector = 0; sector < totalSectors; sector++){
-		ata_wait_irq(atadev);
+		int res = ata_wait_irq(atadev);
+		if (IS_STAT_ERR(res)){
+			return res;
+		}
 
 		if (ata_status(atadev) & ATA_SR_ERR){
 			return -inb_p(ATA_IO(ch, ATA_REG_ERROR));
@@ -80,8 +93,6 @@ static int _pio_read(struct ATADevice* atadev, void* buffer, int totalSectors){
 
 		insw(ATA_IO(ch, ATA_REG_DATA), ptr, WORDS_PER_SECTOR);
 		ptr += WORDS_PER_SECTOR;
-
-		atadev->irqTriggered = 0;
 	}
 
 	return SUCCESS;
@@ -92,7 +103,10 @@ static int _pio_write(struct ATADevice* atadev, const void* buffer, int totalSec
 	struct ATAChannel* ch = atadev->channel;
 	
 	for(int sector = 0; sector < totalSectors; sector++){
-		ata_wait_irq(atadev);
+		int res = ata_wait_irq(atadev);
+		if (IS_STAT_ERR(res)){
+			return res;
+		}
 
 		if (ata_status(atadev) & ATA_SR_ERR){
 			return -inb_p(ATA_IO(ch, ATA_REG_ERROR));
@@ -101,11 +115,9 @@ static int _pio_write(struct ATADevice* atadev, const void* buffer, int totalSec
 		for (int i = 0; i < WORDS_PER_SECTOR; i++) {
 			outw_p(ATA_IO(ch, ATA_REG_DATA), *ptr++);
 		}
-
-		atadev->irqTriggered = 0;
 	}
 
-	return ata_flush(atadev);
+	return _ata_flush(atadev);
 }
 
 static int _ata_pio_common(struct file *file, void *buffer, uint32_t count, uint8_t cmd_pio, uint8_t cmd_pio_ext, int is_write) {
@@ -127,8 +139,11 @@ static int _ata_pio_common(struct file *file, void *buffer, uint32_t count, uint
 	uint64_t lba = pos / SECTOR_SIZE;
 	uint16_t totalSectors = count / SECTOR_SIZE;
 
+	// A second command would clobber the registers and the completion of this one
+	ata_channel_lock(atadev->channel);
+
 	atadev->channel->active = atadev;
-	atadev->irqTriggered = 0;
+	reinit_completion(&atadev->irqDone);
 
 	int ret;
 	if (lba > 0x0FFFFFFF && atadev->info.isLBA48) {
@@ -136,17 +151,19 @@ static int _ata_pio_common(struct file *file, void *buffer, uint32_t count, uint
 	} else if (lba < 0x0FFFFFFF && totalSectors < 0xFF) {
 		ret = _pio_28_io_cmd(atadev, cmd_pio, lba, totalSectors);
 	} else {
-		return OUT_OF_BOUNDS;
+		ret = OUT_OF_BOUNDS;
 	}
 
-	if (IS_STAT_ERR(ret)) {
-		return ret;
+	if (!IS_STAT_ERR(ret)) {
+		if (is_write)
+			ret = _pio_write(atadev, buffer, totalSectors);
+		else
+			ret = _pio_read(atadev, buffer, totalSectors);
 	}
 
-	if (is_write)
-		return _pio_write(atadev, buffer, totalSectors);
-	else
-		return _pio_read(atadev, buffer, totalSectors);
+	ata_channel_unlock(atadev->channel);
+
+	return ret;
 }
 
 int ata_read(struct file *file, void *buffer, uint32_t count) {
@@ -1,5 +1,7 @@
 #include <core/sched/task.h>
 #include <core/sched.h>
+#include <core/sched/wait.h>
+#include <core/time.h>
 #include <drivers/ata.h>
 #include <arch/i386/idt.h>
 #include <arch/i386/pic.h>
@@ -17,21 +19,17 @@ static void _ata_irq_handler(struct InterruptFrame* frame){
 	(void)inb_p(ATA_IO(channel, ATA_REG_STATUS));
 
 	if(channel->active){
-		channel->active->irqTriggered = 1;
-
-		struct Task* t = 0x0;
-		while((t = task_dequeue(&channel->active->sleepQueue))){
-			t->state = TASK_READY;
-			scheduler_add_task(t);
-		}
+		complete(&channel->active->irqDone);
 	}
 }
 
 static int8_t _ata_polling(struct ATADevice* atadev){
 	struct ATAChannel* ch = atadev->channel;
-	
+	uint8_t timed = time_has_clocksource();
+	uint64_t deadline = time_monotonic_ns() + (uint64_t)ATA_TIMEOUT_US * 1000;
+
 	int i;
-	for (i = 0; i < TRIES; i++)
+	for (i = 0; timed ? time_monotonic_ns() < deadline : i < TRIES; i++)
 	{
 		uint8_t status = ata_status(atadev);
 		if (status & ATA_SR_ERR) return -inb_p(ATA_IO(ch, ATA_REG_ERROR));
@@ -49,17 +47,10 @@ void ata_register_irq(char channel){
 }
 
 int ata_wait_irq(struct ATADevice* atadev){
-	struct Task* t = pcb_current();
-
-	if(t && t->tid != 0){
-		t->state = TASK_WAITING;
-		task_enqueue(&atadev->sleepQueue, t);
-
-		while(!atadev->irqTriggered){
-			schedule();
-		}
-
-		return OK;
+	// One interrupt per sector, the task sleeps until it comes. Boot
+	// (exec of init) and idle can not sleep and poll the status instead
+	if(wait_can_sleep()){
+		return wait_for_completion_timeout(&atadev->irqDone, (uint64_t)ATA_TIMEOUT_US * 1000);
 	}
 
 	return _ata_polling(atadev);
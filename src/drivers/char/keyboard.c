@@ -1,12 +1,20 @@
 #include <drivers/keyboard.h>
 #include <drivers/terminal.h>
+#include <memory/memstat.h>
+#include <core/sched/wait.h>
 #include <arch/i386/idt.h>
 #include <io/ports.h>
 #include <lib/mem.h>
+#include <def/err.h>
+#include <uaccess.h>
+#include <syscall.h>
 #include <stdint.h>
 
 /*
  * Simple PS/2 keyboard driver
+ *
+ * Keys are also kept in a small ring for readers, a reader sleeps on
+ * the wait queue until the interrupt brings a key.
  */
 
 #define _PS2_COMMAND_PORT 0x64
@@ -26,6 +34,10 @@
 #define SCANCODE_NUMLOCK 0x45
 #define SCANCODE_SCROLLLOCK 0x46
 
+#define SCANCODE_M 0x32
+
+#define _INPUT_SIZE 256 // Power of two
+
 #define CH_TO_LOWER(c) ((c >= 'A' && c <= 'Z') ? (c + 32) : c)
 #define CH_TO_UPPER(c) ((c >= 'a' && c <= 'z') ? (c - 32) : c)
 
@@ -49,6 +61,11 @@ static const char _scancode_us_table_shift[128] = {
 static keyboard_callback_t _kb_callback = 0x0;
 static kb_state_t _kb_state;
 
+static char _input[_INPUT_SIZE];
+static uint32_t _inputHead = 0; // Next key to read
+static uint32_t _inputTail = 0; // Next free slot, both only grow
+static struct wait_queue_head _inputWait;
+
 static char _translate_scancode(uint8_t scancode){
 	char key = 0;
 
@@ -99,9 +116,27 @@ static inline void _keyboard_handle_scancode(uint8_t sc){
 		return;
 	}
 
+	// Ctrl+Alt+M, memory report on the serial port
+	if(!release && code == SCANCODE_M && _kb_state.ctrl && _kb_state.alt){
+		memstat_dump();
+		return;
+	}
+
 	if(!release){
 		char key = _translate_scancode(code);
-		if(key && _kb_callback){
+		if(!key){
+			return;
+		}
+
+		// Full, the oldest key is dropped
+		if(_inputTail - _inputHead == _INPUT_SIZE){
+			_inputHead++;
+		}
+
+		_input[_inputTail++ & (_INPUT_SIZE - 1)] = key;
+		wake_up_one(&_inputWait);
+
+		if(_kb_callback){
 			_kb_callback(key);
 		}
 	}
@@ -118,6 +153,10 @@ void keyboard_init(){
 
 	_kb_callback = 0x0;
 	memset(&_kb_state, 0, sizeof(kb_state_t));
+
+	_inputHead = 0;
+	_inputTail = 0;
+	wait_queue_init(&_inputWait);
 }
 
 void keyboard_set_callback(keyboard_callback_t callback){
@@ -127,3 +166,38 @@ void keyboard_set_callback(keyboard_callback_t callback){
 kb_state_t* keyboard_get_state(){
 	return &_kb_state;
 }
+
+int keyboard_read(char* buffer, uint32_t size){
+	if(!buffer || !size){
+		return INVALID_ARG;
+	}
+
+	int res = wait_event(&_inputWait, _inputHead != _inputTail);
+	if(res != SUCCESS){
+		return res;
+	}
+
+	uint32_t count = 0;
+	while(count < size && _inputHead != _inputTail){
+		buffer[count++] = _input[_inputHead++ & (_INPUT_SIZE - 1)];
+	}
+
+	// Keys left for the next reader in line
+	if(_inputHead != _inputTail){
+		wake_up_one(&_inputWait);
+	}
+
+	return count;
+}
+
+SYSCALL_DEFINE2(read_terminal, char*, buffer, uint32_t, size){
+	char kbuff[_INPUT_SIZE];
+
+	int res = keyboard_read(kbuff, size < sizeof(kbuff) ? size : sizeof(kbuff));
+	if(IS_STAT_ERR(res)){
+		return res;
+	}
+
+	int copied = copy_to_user(kbuff, buffer, res);
+	return copied == SUCCESS ? res : copied;
+}
@@ -2,11 +2,15 @@ global _entry_isr80h_32
 
 extern isr80h_handler
 
+; Same layout as the ISR stubs, the frame is a struct InterruptFrame
 _entry_isr80h_32:
+    push 0    ; Dummy error code
+    push 0x80
     pushad
     push esp
     call isr80h_handler
     add esp, 4
     mov [esp+28], eax
     popad
+    add esp, 8
     iretd
\ No newline at end of file
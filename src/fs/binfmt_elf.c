@@ -3,6 +3,7 @@
 #include <fs/vfs.h>
 #include <mmu.h>
 #include <core/sched.h>
+#include <def/config.h>
 #include <def/err.h>
 
 static int load_elf_binarie(struct binprm *bprm);
@@ -61,6 +62,7 @@ static int load_elf_binarie(struct binprm *bprm){
 	}
 
 	uint8_t flags = FPAGING_P | FPAGING_US;
+	uintptr_t imageEnd = 0;
 
 	for (int i = 0; i < ehdr->e_phnum; i++) {
 		struct Elf32_Phdr* phdr = &phdrs[i];
@@ -68,42 +70,40 @@ static int load_elf_binarie(struct binprm *bprm){
 			continue;
 		}
 
-		void* segment = kmalloc(phdr->p_memsz);
-		if(!segment){
-			return NO_MEMORY;
-		}
-
-		vfs_lseek(bprm->file, phdr->p_offset, SEEK_SET);
-		int readBytes = vfs_read(bprm->file, segment, phdr->p_filesz);
+		uint8_t segmentFlags = flags | (phdr->p_flags & PF_W ? FPAGING_RW : 0);
+		uintptr_t segmentEnd = phdr->p_vaddr + phdr->p_memsz;
 
-		if(IS_STAT_ERR(readBytes) || readBytes != phdr->p_filesz){
-			kfree(segment);
-			return READ_FAIL;
+		if(phdr->p_filesz > phdr->p_memsz || segmentEnd < phdr->p_vaddr || segmentEnd > KERNEL_VIRT_BASE){
+			return INVALID_FORMAT;
 		}
 
-		// Zero extra part (BSS)
-		memset(segment + phdr->p_filesz, 0x0, phdr->p_memsz - phdr->p_filesz);
-
-		res = vma_add(bprm->mm, 
-			(void*)phdr->p_vaddr, 
-			segment, 
-			phdr->p_memsz, 
-			flags | (phdr->p_flags & PF_W ? FPAGING_RW : 0),
-			1
-		);
-
-		mmu_map_pages(
+		// Nothing is read here, pages are filled from the file on first touch
+		res = vma_add_file(bprm->mm,
 			(void*)phdr->p_vaddr,
-			mmu_translate(segment),
 			phdr->p_memsz,
-			flags | (phdr->p_flags & PF_W ? FPAGING_RW : 0)
+			segmentFlags,
+			bprm->file,
+			phdr->p_offset,
+			phdr->p_filesz
 		);
 
 		if(res != SUCCESS){
 			return res;
 		}
+
+		if(segmentEnd > imageEnd){
+			imageEnd = segmentEnd;
+		}
 	}
 
+	// The heap starts at the first page past the image
+	bprm->mm->brkStart = (uintptr_t)paging_align_address((void*)imageEnd);
+	bprm->mm->brk = bprm->mm->brkStart;
+
+	// The address space keeps the executable open for its file regions
+	bprm->mm->exeFile = bprm->file;
+	bprm->file = 0x0;
+
 	bprm->entryPoint = (void*)ehdr->e_entry;
 
 	return SUCCESS;
@@ -15,42 +15,49 @@ static struct binfmt* fmts[] = {
 	0x0
 };
 
-static struct binprm* alloc_binprm(char* filename, int flags) {
-	struct binprm* bprm;
-	struct file* file;
+static void bprm_free(struct binprm* bprm);
 
-	file = vfs_open(filename, flags);
-	if (IS_ERR(file)) {
-		return ERR_CAST(file);
+static struct binprm* alloc_binprm(char* filename, int flags) {
+	struct arena* arena = arena_create(0);
+	if (!arena) {
+		return ERR_PTR(NO_MEMORY);
 	}
 
-	bprm = (struct binprm*)kzalloc(sizeof(struct binprm));
+	struct binprm* bprm = (struct binprm*)arena_zalloc(arena, sizeof(struct binprm));
 	if (!bprm) {
-		vfs_close(file);
+		arena_destroy(arena);
 		return ERR_PTR(NO_MEMORY);
 	}
 
-	struct PagingDirectory* dir = mmu_create_page();
-	mmu_copy_kernel_to_directory(dir);
+	bprm->arena = arena;
+	bprm->filename = filename;
+	bprm->interp = filename;
 
-	if(IS_ERR_OR_NULL(dir)){
-		kfree(bprm);
-		vfs_close(file);
+	// From here on bprm_free() undoes whatever was set up
+	bprm->file = vfs_open(filename, flags);
+	if (IS_ERR(bprm->file)) {
+		int res = PTR_ERR(bprm->file);
+		bprm->file = NULL;
+		bprm_free(bprm);
+		return ERR_PTR(res);
+	}
+
+	struct PagingDirectory* dir = mmu_create_page();
+	if (IS_ERR_OR_NULL(dir)) {
+		bprm_free(bprm);
 		return ERR_PTR(NO_MEMORY);
 	}
 
-	struct mm_struct* mm = (struct mm_struct*)kzalloc(sizeof(struct mm_struct));
+	mmu_copy_kernel_to_directory(dir);
+
+	// Outlives the arena, handed to the process on success
+	struct mm_struct* mm = mm_alloc();
 	if (!mm) {
-		kfree(bprm);
-		vfs_close(file);
 		mmu_destroy_page(dir);
+		bprm_free(bprm);
 		return ERR_PTR(NO_MEMORY);
 	}
 
-	bprm->filename = filename;
-	bprm->interp = filename;
-	bprm->file = file;
-
 	mm->pageDirectory = dir;
 	bprm->mm = mm;
 
@@ -70,11 +77,7 @@ static void bprm_free(struct binprm* bprm) {
 		vma_destroy(bprm->mm);
 	}
 
-	if (bprm->interp != bprm->filename){
-		kfree((void*)bprm->interp);
-	}
-
-	kfree(bprm);
+	arena_destroy(bprm->arena);
 }
 
 static int bprm_load(struct binprm* bprm) {
@@ -114,7 +117,7 @@ static inline int _count_args_kernel(const char* const* argv) {
 
 static int _copy_args_kernel(int count, const char* const* argv, struct binprm* bprm){
 	uint8_t* top = (uint8_t*)bprm->curMemTop;
-	uint8_t* stack_base = (uint8_t*)((uintptr_t)top - PROC_USER_STACK_SIZE);
+	uint8_t* stack_base = (uint8_t*)(PROC_USER_STACK_VIRUTAL_TOP - PAGING_PAGE_SIZE);
 
 	uint8_t* argPtrs[count];
 	for (int i = count-1; i >= 0; i--) {
@@ -183,80 +186,45 @@ int kernel_exec(const char* pathname, const char* argv[], const char* envp[]) {
 
 	bprm->envc = res;
 
-	void* newStack = kzalloc(PROC_USER_STACK_SIZE);
-	if(!newStack){
-		res = NO_MEMORY;
-		goto out_fbrpm;
-	}
-
-	void* newKernelStack = kzalloc(PROC_KERNEL_STACK_SIZE);
-	if(!newKernelStack){
-		res = NO_MEMORY;
-		kfree(newStack);
-		goto out_fbrpm;
-	}
-
-	bprm->curMemTop = ((uintptr_t)newStack + PROC_USER_STACK_SIZE);
-
-	res = _copy_args_kernel(bprm->argc, argv, bprm);
-	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
-	}
+	uint8_t userFlags = (FPAGING_P | FPAGING_RW | FPAGING_US);
 
-	res = _copy_args_kernel(bprm->envc, envp, bprm);
-	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
-	}
-
-	res = mmu_map_pages(
+	// Regions first, so bprm_free() releases whatever got mapped on failure
+	res = vma_add(bprm->mm, 
 		(void*)PROC_USER_STACK_VIRUTAL_BUTTOM, 
-		mmu_translate(newStack), 
+		0x0, 
 		PROC_USER_STACK_SIZE, 
-		(FPAGING_P | FPAGING_RW | FPAGING_US)
+		userFlags,
+		1
 	);
 
 	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
+		goto out_fbrpm;
 	}
 
-	res = vma_add(bprm->mm, 
-		(void*)PROC_USER_STACK_VIRUTAL_BUTTOM, 
-		newStack, 
-		PROC_USER_STACK_SIZE, 
-		(FPAGING_P | FPAGING_RW | FPAGING_US),
-		1
-	);
-
+	// Only the page holding the arguments is backed now, the rest faults in
+	res = vma_populate(bprm->mm, (void*)(PROC_USER_STACK_VIRUTAL_TOP - PAGING_PAGE_SIZE), PAGING_PAGE_SIZE);
 	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
+		goto out_fbrpm;
 	}
 
-	res = mmu_map_pages(
-		(void*)PROC_KERNEL_STACK_VIRTUAL_BUTTOM, 
-		mmu_translate(newKernelStack), 
-		PROC_KERNEL_STACK_SIZE, 
-		(FPAGING_P | FPAGING_RW)
-	);
+	bprm->mm->mmapBase = (void*)PROC_MMAP_VIRTUAL_BASE;
 
+	// The new directory is loaded, arguments go straight to the user stack
+	bprm->curMemTop = PROC_USER_STACK_VIRUTAL_TOP;
+
+	res = _copy_args_kernel(bprm->argc, argv, bprm);
 	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
+		goto out_fbrpm;
 	}
 
-	res = vma_add(bprm->mm,
-		(void*)PROC_KERNEL_STACK_VIRTUAL_BUTTOM,
-		newKernelStack,
-		PROC_KERNEL_STACK_SIZE,
-		(FPAGING_P | FPAGING_RW),
-		1
-	);
-
+	res = _copy_args_kernel(bprm->envc, envp, bprm);
 	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
+		goto out_fbrpm;
 	}
 
 	res = bprm_load(bprm);
 	if (IS_STAT_ERR(res)) {
-		goto out_fstack;
+		goto out_fbrpm;
 	}
 
 	struct Task* task = pcb_current();
@@ -269,11 +237,7 @@ int kernel_exec(const char* pathname, const char* argv[], const char* envp[]) {
 	process->mm = bprm->mm;
 	bprm->mm = NULL;
 
-	task->userStack = newStack;
-	memset(task->userStack, 0, PROC_USER_STACK_SIZE);
-
-	task->kernelStack = newKernelStack;
-	memset(task->kernelStack, 0, PROC_KERNEL_STACK_SIZE);
+	task->userStack = (void*)PROC_USER_STACK_VIRUTAL_BUTTOM;
 
 	// TODO: Implement -> Close all file descriptors
 
@@ -281,16 +245,11 @@ int kernel_exec(const char* pathname, const char* argv[], const char* envp[]) {
 
 	task->regs.eip = (uint32_t)bprm->entryPoint;
 
-	task->regs.esp = PROC_USER_STACK_VIRUTAL_TOP;
+	task->regs.esp = bprm->curMemTop;
 	task->regs.ebp = task->regs.esp;
     task->regs.ss = USER_DATA_SEGMENT;
     task->regs.cs = USER_CODE_SEGMENT;
 
-	goto out_fbrpm;
-
-out_fstack:
-	kfree(newStack);
-	kfree(newKernelStack);
 out_fbrpm:
 	bprm_free(bprm);
 	return res;
@@ -2,6 +2,7 @@
 #include <fs/vfs.h>
 #include <def/err.h>
 #include <mmu.h>
+#include <memory/vmalloc.h>
 #include <io/stream.h>
 #include <lib/string.h>
 
@@ -15,11 +16,14 @@ struct inode_operations vfat_fs_iop = {
     .setarrt = fat_setarrt
 };
 
+struct kmem_cache fat_fd_cache = KMEM_CACHE_INIT("fat_fd", sizeof(struct FATFileDescriptor));
+
 struct file_operations vfat_fs_fop = {
     .read = fat_read,
     .write = fat_write,
     .lseek = fat_lseek,
-    .close = fat_close
+    .close = fat_close,
+    .bmap = fat_bmap
 };
 
 static int8_t _valid_fat_sector(const uint8_t* sector0){
@@ -119,23 +123,21 @@ static int fat_mount(struct superblock* sb, struct blkdev* bdev){
         return INVALID_ARG;
     }
 
-    struct inode* rootino = (struct inode*)kmalloc(sizeof(struct inode));
+    struct inode* rootino = (struct inode*)kmem_cache_alloc(&inode_cache);
     if(!rootino){
         return NO_MEMORY;
     }
 
-    struct FATFileDescriptor* root_fd = (struct FATFileDescriptor*)kmalloc(sizeof(struct FATFileDescriptor));
+    struct FATFileDescriptor* root_fd = (struct FATFileDescriptor*)kmem_cache_alloc(&fat_fd_cache);
     if(!root_fd){
-        kfree(sb);
-        kfree(rootino);
+        kmem_cache_free(&inode_cache, rootino);
         return NO_MEMORY;
     }
 
     struct FAT* fat = fat_init(bdev);
     if(IS_ERR(fat)){
-        kfree(sb);
-        kfree(rootino);
-        kfree(root_fd);
+        kmem_cache_free(&inode_cache, rootino);
+        kmem_cache_free(&fat_fd_cache, root_fd);
         return PTR_ERR(fat);
     }
     
@@ -173,13 +175,13 @@ static int fat_unmount(struct superblock* sb){
         switch (fat->type)
         {
         case FAT_TYPE_12:
-            kfree(fat->table.fat12);
+            vfree(fat->table.fat12);
             break;
         case FAT_TYPE_16:
-            kfree(fat->table.fat16);
+            vfree(fat->table.fat16);
             break;
         case FAT_TYPE_32:
-            kfree(fat->table.fat32);
+            vfree(fat->table.fat32);
             break;
         default:
             return INVALID_FS;
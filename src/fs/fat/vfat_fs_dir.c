@@ -86,14 +86,14 @@ struct inode* fat_lookup(struct inode *dir, const char *name){
                 continue;
             }
 
-            struct inode* inode = (struct inode*)kmalloc(sizeof(struct inode));
+            struct inode* inode = (struct inode*)kmem_cache_alloc(&inode_cache);
             if(!inode){
                 return ERR_PTR(NO_MEMORY);
             }
 
-            struct FATFileDescriptor* newfd = (struct FATFileDescriptor*)kmalloc(sizeof(struct FATFileDescriptor));
+            struct FATFileDescriptor* newfd = (struct FATFileDescriptor*)kmem_cache_alloc(&fat_fd_cache);
             if(!newfd){
-                kfree(inode);
+                kmem_cache_free(&inode_cache, inode);
                 return ERR_PTR(NO_MEMORY);
             }
 
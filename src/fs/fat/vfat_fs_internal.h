@@ -163,6 +163,7 @@ struct FATFileDescriptor{
 typedef int (*_fat_loader_func_t)(struct FAT*, struct Stream* stream, const uint8_t* sector0Buffer);
 
 extern _fat_loader_func_t loaders[];
+extern struct kmem_cache fat_fd_cache;
 extern struct inode_operations vfat_fs_iop;
 extern struct file_operations vfat_fs_fop;
 
@@ -176,6 +177,7 @@ int fat_read(struct file *file, void *buffer, uint32_t count);
 int fat_write(struct file *file, const void *buffer, uint32_t count);
 int fat_lseek(struct file *file, int offset, int whence);
 int fat_close(struct file *file);
+int fat_bmap(struct file *file, uint32_t offset, struct file_extent *extent);
 
 int fat_update(struct FAT* fat);
 
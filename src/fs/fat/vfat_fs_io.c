@@ -167,6 +167,48 @@ out:
     return totalWritten;
 }
 
+// Device range holding offset, extended over the clusters that follow it on disk
+int fat_bmap(struct file *file, uint32_t offset, struct file_extent *extent){
+    if(!file || !extent){
+        return INVALID_ARG;
+    }
+
+    struct FATFileDescriptor* fd = (struct FATFileDescriptor*)file->inode->private_data;
+    struct FAT* fat = fd->fat;
+
+    if (fd->entry.attr & ATTR_DIRECTORY){
+        return NOT_SUPPORTED;
+    }
+
+    if(offset >= fd->entry.fileSize){
+        return OUT_OF_BOUNDS;
+    }
+
+    uint32_t cluster = fd->firstCluster;
+    for(uint32_t i = offset / fat->clusterSize; i > 0; i--){
+        cluster = fat_next_cluster(fat, cluster);
+        if(fat_is_eof(fat, cluster)){
+            return END_OF_FILE;
+        }
+    }
+
+    uint32_t first = cluster;
+    uint32_t run = 1;
+    for(uint32_t next = fat_next_cluster(fat, cluster); next == cluster + 1; next = fat_next_cluster(fat, cluster)){
+        cluster = next;
+        run++;
+    }
+
+    uint32_t clusterOffset = offset % fat->clusterSize;
+    uint32_t length = run * fat->clusterSize - clusterOffset;
+
+    extent->bdev = fat->stream->bdev;
+    extent->start = _SEC((uint64_t)fat_cluster_to_lba(fat, first)) + clusterOffset;
+    extent->length = length < fd->entry.fileSize - offset ? length : fd->entry.fileSize - offset;
+
+    return SUCCESS;
+}
+
 int fat_lseek(struct file *file, int offset, int whence){
     if(!file){
         return INVALID_ARG;
@@ -2,6 +2,7 @@
 #include <def/err.h>
 #include <io/stream.h>
 #include <mmu.h>
+#include <memory/vmalloc.h>
 #include <drivers/terminal.h>
 
 static int fat12_load(struct FAT* fat, struct Stream* stream, const uint8_t* sector0Buffer){
@@ -34,14 +35,14 @@ static int fat12_load(struct FAT* fat, struct Stream* stream, const uint8_t* sec
         return INVALID_FS;
     }
 
-    uint8_t *table = (uint8_t *)kmalloc(fatBytes);
+    uint8_t *table = (uint8_t *)vmalloc(fatBytes);
     if (!table){
         return NO_MEMORY;
     }
 
     stream_seek(stream, _SEC(fatStartSector), SEEK_SET);
     if ((status = stream_read(stream, table, fatBytes)) != SUCCESS) {
-        kfree(table);
+        vfree(table);
         return status;
     }
 
@@ -84,14 +85,14 @@ static int fat16_load(struct FAT* fat, struct Stream* stream, const uint8_t* sec
         return INVALID_FS;
     }
 
-    uint16_t *table = (uint16_t *)kmalloc(fatBytes);
+    uint16_t *table = (uint16_t *)vmalloc(fatBytes);
     if (!table){
         return NO_MEMORY;
     }
 
     stream_seek(stream, _SEC(fatStartSector), SEEK_SET);
     if ((status = stream_read(stream, table, fatBytes)) != SUCCESS) {
-        kfree(table);
+        vfree(table);
         return status;
     }
 
@@ -138,14 +139,14 @@ static int fat32_load(struct FAT* fat, struct Stream* stream, const uint8_t* sec
         fat->fsInfo.nextFreeCluster = -1;
     }
 
-    uint32_t *table = (uint32_t *)kmalloc(fatBytes);
+    uint32_t *table = (uint32_t *)vmalloc(fatBytes);
     if (!table){
         return NO_MEMORY;
     }
 
     stream_seek(stream, _SEC(fatStartSector), SEEK_SET);
     if((status = stream_read(stream, table, fatBytes)) != SUCCESS){
-        kfree(table);
+        vfree(table);
         return status;
     }
 
@@ -2,6 +2,8 @@
 #include <def/err.h>
 #include <memory/kheap.h>
 
+static struct kmem_cache _fileCache = KMEM_CACHE_INIT("file", sizeof(struct file));
+
 struct file* vfs_open(const char *restrict path, uint32_t flags){
     if(!path){
         return ERR_PTR(INVALID_ARG);
@@ -12,7 +14,7 @@ struct file* vfs_open(const char *restrict path, uint32_t flags){
         return ERR_PTR(PTR_ERR(ino));
     }
 
-    struct file* f = (struct file*)kmalloc(sizeof(struct file));
+    struct file* f = (struct file*)kmem_cache_alloc(&_fileCache);
     if(!f){
         return ERR_PTR(NO_MEMORY);
     }
@@ -20,6 +22,7 @@ struct file* vfs_open(const char *restrict path, uint32_t flags){
     f->inode = ino;
     f->pos = 0;
     f->flags = flags;
+    f->count = 1;
     f->private_data = NULL;
     f->f_op = ino->i_fop;
 
@@ -31,13 +34,17 @@ int vfs_close(struct file *file){
         return INVALID_ARG;
     }
 
+    if(--file->count){
+        return SUCCESS;
+    }
+
     if(!file->f_op || !file->f_op->close){
         return NOT_SUPPORTED;
     }
 
     int res = file->f_op->close(file);
     inode_dispose(file->inode);
-    kfree(file);
+    kmem_cache_free(&_fileCache, file);
 
     return res;
 }
\ No newline at end of file
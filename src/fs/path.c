@@ -1,6 +1,7 @@
 #include <fs/vfs.h>
 #include <def/err.h>
 #include <memory/kheap.h>
+#include <memory/arena.h>
 #include <lib/mem.h>
 #include <lib/string.h>
 #include <def/config.h>
@@ -32,38 +33,72 @@ static struct inode *_find_mount_for_path(const char *path, const char **out_rel
     return result;
 }
 
-static inline struct inode* vfs_traverse_path(const char* path){
+// Scratch space of path walks, reset after each one. Walks do not nest.
+static struct arena* _walkArena = NULL;
+
+// Split path in place into its components, NULL terminated
+static char** _split_path(struct arena* arena, char* path){
+    size_t count = 0;
+    for (char* c = path; *c; c++) {
+        if (*c != '/' && (c == path || c[-1] == '/')) {
+            count++;
+        }
+    }
+
+    char** parts = (char**)arena_alloc(arena, sizeof(char*) * (count + 1));
+    if (!parts) {
+        return NULL;
+    }
+
+    size_t i = 0;
+    for (char* c = path; *c; c++) {
+        if (*c == '/') {
+            *c = '\0';
+        } else if (c == path || c[-1] == '\0') {
+            parts[i++] = c;
+        }
+    }
+
+    parts[i] = NULL;
+    return parts;
+}
+
+static struct inode* vfs_traverse_path(const char* path){
     if(!path || path[0] != '/' || strlen(path) > PATH_MAX){
         return ERR_PTR(INVALID_ARG);
     }
 
+    if (!_walkArena && !(_walkArena = arena_create(0))) {
+        return ERR_PTR(NO_MEMORY);
+    }
+
     const char *relative_path;
     struct inode *root = _find_mount_for_path(path, &relative_path);
 
-    char pathcopy[PATH_MAX];
-    memset(pathcopy, 0x0, sizeof(pathcopy));
-    strncpy(pathcopy, relative_path, PATH_MAX);
-
-    pathcopy[PATH_MAX - 1] = '\0';
-
     struct inode *current = root;
     struct inode *next = NULL;
 
-    char *token = strtok(pathcopy, "/");
-    while(token){
-        if (!current->i_op || !current->i_op->lookup)
-            return ERR_PTR(NOT_SUPPORTED);
+    char* pathcopy = arena_strdup(_walkArena, relative_path);
+    char** parts = pathcopy ? _split_path(_walkArena, pathcopy) : NULL;
+    if (!parts) {
+        current = ERR_PTR(NO_MEMORY);
+        goto out;
+    }
 
-        next = current->i_op->lookup(current, token);
-        if (IS_ERR(next)) {
-            return next;
+    for (int i = 0; parts[i]; i++) {
+        if (!current->i_op || !current->i_op->lookup) {
+            next = ERR_PTR(NOT_SUPPORTED);
+        } else {
+            next = current->i_op->lookup(current, parts[i]);
         }
 
         if (current != root)
             inode_dispose(current);
-        
+
         current = next;
-        token = strtok(NULL, "/");
+        if (IS_ERR(current)) {
+            goto out;
+        }
     }
 
     if(!current->i_fop || !current->i_fop->read){
@@ -71,9 +106,11 @@ static inline struct inode* vfs_traverse_path(const char* path){
             inode_dispose(current);
         }
 
-        return ERR_PTR(INVALID_FILE);
+        current = ERR_PTR(INVALID_FILE);
     }
 
+out:
+    arena_reset(_walkArena);
     return current;
 }
 
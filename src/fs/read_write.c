@@ -1,5 +1,6 @@
 #include <fs/vfs.h>
 #include <def/status.h>
+#include <core/sched/wait.h>
 
 int vfs_read(struct file *file, void *buffer, uint32_t size){
     if(!file || !file->f_op){
@@ -32,3 +33,45 @@ int vfs_lseek(struct file *file, int offset, int whence){
     
     return file->f_op->lseek(file, offset, whence);
 }
+
+int vfs_bmap(struct file *file, uint32_t offset, struct file_extent *extent){
+    if(!file || !file->f_op || !file->f_op->bmap){
+        return NOT_SUPPORTED;
+    }
+
+    return file->f_op->bmap(file, offset, extent);
+}
+
+// One positioned read at a time, the seek and the read may sleep in the driver
+static uint8_t _preadBusy = 0;
+static struct wait_queue_head _preadWait = {
+    .waiters = { &_preadWait.waiters, &_preadWait.waiters }
+};
+
+int vfs_pread(struct file *file, void *buffer, uint32_t size, uint32_t offset){
+    if(!file || !file->f_op){
+        return READ_FAIL;
+    }
+
+    if(!file->f_op->read || !file->f_op->lseek){
+        return NOT_SUPPORTED;
+    }
+
+    (void)wait_event(&_preadWait, !_preadBusy);
+    _preadBusy = 1;
+
+    // Shared opens (fork) keep their position, only this read moves it
+    uint32_t pos = file->pos;
+
+    int res = file->f_op->lseek(file, offset, SEEK_SET);
+    if(!IS_STAT_ERR(res)){
+        res = file->f_op->read(file, buffer, size);
+    }
+
+    file->f_op->lseek(file, pos, SEEK_SET);
+
+    _preadBusy = 0;
+    wake_up_one(&_preadWait);
+
+    return res;
+}
@@ -8,6 +8,8 @@ static struct filesystem* _registered_filesystems[FILESYSTEMS_MAX] = { 0x0 };
 struct mount* mnt_root = 0x0;
 struct inode* vfs_root_node = 0x0;
 
+struct kmem_cache inode_cache = KMEM_CACHE_INIT("inode", sizeof(struct inode));
+
 static inline void _register_mount(struct mount* mount){
     mount->next = 0x0;
 
@@ -0,0 +1,34 @@
+#ifndef _CLOCKEVENT_H
+#define _CLOCKEVENT_H
+
+#include <arch/i386/idt.h>
+#include <stdint.h>
+
+// One-shot timer hardware, programmed in microseconds
+struct clock_event_device {
+	const char* name;
+	uint8_t vector;
+
+	uint32_t minDeltaUs;
+	uint32_t maxDeltaUs; // Longer deadlines are chained shots
+
+	void (*set_next_event)(uint32_t us);
+	uint32_t (*remaining)(); // Left of the current shot
+	void (*shutdown)();
+	void (*ack)(); // End of interrupt
+};
+
+typedef void (*clockevent_handler_t)(struct InterruptFrame* frame);
+
+int clockevent_init();
+const char* clockevent_name();
+void clockevent_set_handler(clockevent_handler_t handler);
+
+// The handler runs once, us from now, until the timer is programmed again
+void clockevent_program(uint32_t us);
+void clockevent_stop();
+
+// Microseconds since the last call or clockevent_program()
+uint32_t clockevent_elapsed();
+
+#endif
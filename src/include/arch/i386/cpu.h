@@ -0,0 +1,96 @@
+#ifndef _CPU_H
+#define _CPU_H
+
+#include <stdint.h>
+
+// CPUID leaf 1, EDX
+#define CPUID_FEAT_EDX_PSE (1u << 3)
+#define CPUID_FEAT_EDX_TSC (1u << 4)
+#define CPUID_FEAT_EDX_MSR (1u << 5)
+#define CPUID_FEAT_EDX_APIC (1u << 9)
+#define CPUID_FEAT_EDX_PGE (1u << 13)
+
+#define MSR_APIC_BASE 0x1B
+
+// Control register 4
+#define CR4_PSE (1u << 4)
+#define CR4_PGE (1u << 7)
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx){
+	__asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+static inline uint8_t cpu_has_feature_edx(uint32_t feature){
+	uint32_t eax, ebx, ecx, edx;
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	return (edx & feature) != 0;
+}
+
+static inline uint32_t read_cr4(){
+	uint32_t cr4;
+	__asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+	return cr4;
+}
+
+static inline void write_cr4(uint32_t cr4){
+	__asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+static inline uint32_t read_cr3(){
+	uint32_t cr3;
+	__asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+	return cr3;
+}
+
+static inline void write_cr3(uint32_t cr3){
+	__asm__ volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+// Disable interrupts and return the previous EFLAGS for cpu_irq_restore()
+static inline uint32_t cpu_irq_save(){
+	uint32_t flags;
+	__asm__ volatile("pushf\n\tpop %0\n\tcli" : "=r"(flags) : : "memory");
+	return flags;
+}
+
+static inline void cpu_irq_restore(uint32_t flags){
+	__asm__ volatile("push %0\n\tpopf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint64_t rdmsr(uint32_t msr){
+	uint32_t lo, hi;
+	__asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value){
+	__asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint64_t rdtsc(){
+	uint32_t lo, hi;
+	__asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+// 64 by 32 bit division without libgcc, two divl from the high word down
+static inline uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t* remainder){
+	uint32_t high = dividend >> 32;
+	uint32_t quotHigh = 0;
+
+	if(high >= divisor){
+		quotHigh = high / divisor;
+		high %= divisor;
+	}
+
+	uint32_t quotLow, rem;
+	__asm__("divl %4" : "=a"(quotLow), "=d"(rem) : "a"((uint32_t)dividend), "d"(high), "rm"(divisor));
+
+	if(remainder){
+		*remainder = rem;
+	}
+
+	return ((uint64_t)quotHigh << 32) | quotLow;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _LAPIC_H
+#define _LAPIC_H
+
+#include <arch/i386/clockevent.h>
+#include <stdint.h>
+
+#define LAPIC_TIMER_VECTOR 0xF0
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+// NOT_SUPPORTED without an enabled local APIC
+int lapic_clockevent_init(struct clock_event_device* dev);
+
+#endif
@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 
-void pic_init(uint32_t frequency);
+void pic_init();
 void pic_send_eoi(uint8_t irq);
 void pic_disable();
 
@@ -0,0 +1,16 @@
+#ifndef _PIT_H
+#define _PIT_H
+
+#include <arch/i386/clockevent.h>
+#include <stdint.h>
+
+#define PIT_FREQUENCY 1193182
+#define PIT_DELAY_MAX_US 54000 // 16 bit counter
+
+int pit_clockevent_init(struct clock_event_device* dev);
+void pit_stop();
+
+// Busy wait on channel 2, used to calibrate the other clocks
+void pit_delay_us(uint32_t us);
+
+#endif
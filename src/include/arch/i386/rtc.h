@@ -0,0 +1,21 @@
+#ifndef _RTC_H
+#define _RTC_H
+
+#include <stdint.h>
+
+struct rtc_time {
+	uint16_t year;
+	uint8_t month; // 1-12
+	uint8_t day; // 1-31
+	uint8_t hour;
+	uint8_t minute;
+	uint8_t second;
+};
+
+// CMOS clock, taken as UTC
+int rtc_read(struct rtc_time* time);
+
+// Seconds since 1970-01-01
+uint32_t rtc_to_epoch(const struct rtc_time* time);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _TSC_H
+#define _TSC_H
+
+#include <stdint.h>
+
+// Calibrated against the PIT, NOT_SUPPORTED without a time stamp counter
+int tsc_init();
+
+// Nanoseconds since tsc_init()
+uint64_t tsc_ns();
+uint32_t tsc_khz();
+
+#endif
@@ -35,5 +35,6 @@ struct TSS
 } __attribute__((packed));
 
 void tss_load(int tss_segment);
+void tss_set_kernel_stack(uint32_t esp0);
 #endif
 
@@ -0,0 +1,30 @@
+#ifndef _BOOT_MEMORY_H
+#define _BOOT_MEMORY_H
+
+#include <stdint.h>
+
+#define E820_MAP_ADDR 0x0500 // E820Map save point
+#define E820_MAX_ENTRIES 32
+
+// Entry types
+#define E820_USABLE           1
+#define E820_RESERVED         2
+#define E820_ACPI_RECLAIMABLE 3
+#define E820_ACPI_NVS         4
+#define E820_BAD              5
+
+struct E820Entry {
+	uint64_t base;
+	uint64_t length;
+	uint32_t type;
+	uint32_t acpi; // ACPI 3.0 extended attributes
+} __attribute__ ((packed));
+
+struct E820Map {
+	uint32_t count;
+	struct E820Entry entries[E820_MAX_ENTRIES];
+} __attribute__ ((packed));
+
+void setup_memory_map();
+
+#endif
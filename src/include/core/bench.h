@@ -0,0 +1,7 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+// In-kernel micro benchmarks, only built with `make bench` (-DKERNEL_BENCH)
+void kernel_bench_run();
+
+#endif
@@ -6,6 +6,8 @@
 #include <def/config.h>
 #include <stdint.h>
 
+struct arena;
+
 struct Process
 {
     uint16_t pid;
@@ -21,10 +23,13 @@ struct Process
     char **envp;
 
     char *pwd;
+
+    struct arena* arena; // Holds the process itself, argv and envp
 } __attribute__((packed));
 
 struct Process *process_get(uint16_t pid);
 struct Process *process_create(const char *name, const char *pwd, int argc, char **argv, int envc, char **envp);
+struct Process *process_fork(struct Process *parent);
 
 int process_terminate(struct Process *process);
 int process_add_task(struct Process *process, struct Task *task);
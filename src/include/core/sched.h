@@ -13,11 +13,15 @@ asmlinkage void schedule();
 void scheduler_init();
 void scheduler_start();
 void scheduler_add_task(struct Task* task);
+void scheduler_wake_task(struct Task* task);
 void scheduler_remove_task(struct Task* task);
+void scheduler_timers_changed();
+__no_return void scheduler_exit_current();
 
 // Process Control Block
 int __must_check pcb_save_from_frame(struct Task* task, struct InterruptFrame* frame);
 int __must_check pcb_save_context(struct Registers* regs);
+struct InterruptFrame* pcb_user_frame(struct Task* task);
 
 struct Task* pcb_current();
 int __must_check pcb_switch(struct Task* task);
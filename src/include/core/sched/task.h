@@ -26,7 +26,9 @@ struct Task {
     void* kernelStack;
 
     enum TaskState state;
-    int priority;
+    int priority; // Base level, 0 to SCHED_PRIORITY_MAX
+    int level; // Run queue, drops when the slice runs out and climbs back on wakeups
+    uint32_t sliceUs; // Left in the current time slice
 
     // Keep track on terminate
     struct Task* next;
@@ -0,0 +1,93 @@
+#ifndef _WAIT_H
+#define _WAIT_H
+
+#include <core/sched/task.h>
+#include <core/timer.h>
+#include <core/time.h>
+#include <lib/list.h>
+#include <def/err.h>
+#include <stdint.h>
+
+#define WAIT_FOREVER 0
+
+struct wait_queue_head {
+	struct list_head waiters;
+};
+
+// On the waiting task's stack, see wait_event_timeout()
+struct wait_queue_entry {
+	struct Task* task;
+	struct wait_queue_head* head; // Queued on, 0x0 once woken
+	struct list_head entry;
+
+	uint8_t timed;
+	struct timer_list timeout;
+};
+
+struct completion {
+	uint32_t done;
+	struct wait_queue_head wait;
+};
+
+void wait_queue_init(struct wait_queue_head* head);
+void wait_entry_init(struct wait_queue_entry* wait, uint64_t timeoutNs);
+
+// The current task is blocked by the next wait_schedule() until woken
+void prepare_to_wait(struct wait_queue_head* head, struct wait_queue_entry* wait);
+void finish_wait(struct wait_queue_entry* wait);
+
+// 0 before the scheduler runs and in the idle task, waits spin there
+uint8_t wait_can_sleep();
+
+// TIMEOUT once the deadline passed, INVALID_STATE if the current task can not sleep
+int wait_schedule(struct wait_queue_entry* wait);
+
+// A woken task is taken off the queue, one wakeup per waiter
+uint8_t wake_up_one(struct wait_queue_head* head);
+void wake_up_all(struct wait_queue_head* head);
+
+// SUCCESS once condition holds, TIMEOUT after ns (WAIT_FOREVER for none)
+#define wait_event_timeout(head, condition, ns) ({ \
+	int __res = SUCCESS; \
+	if(!(condition) && !wait_can_sleep()){ \
+		uint64_t __ns = (ns); \
+		uint64_t __deadline = time_monotonic_ns() + __ns; \
+		while(!(condition)){ \
+			if(__ns != WAIT_FOREVER && time_monotonic_ns() >= __deadline){ \
+				__res = TIMEOUT; \
+				break; \
+			} \
+		} \
+	}else if(!(condition)){ \
+		struct wait_queue_entry __wait; \
+		wait_entry_init(&__wait, ns); \
+		for(;;){ \
+			prepare_to_wait(head, &__wait); \
+			if(condition){ \
+				break; \
+			} \
+			if(IS_STAT_ERR(__res = wait_schedule(&__wait))){ \
+				break; \
+			} \
+		} \
+		finish_wait(&__wait); \
+		if(__res == TIMEOUT && (condition)){ \
+			__res = SUCCESS; \
+		} \
+	} \
+	__res; \
+})
+
+#define wait_event(head, condition) wait_event_timeout(head, condition, WAIT_FOREVER)
+
+void init_completion(struct completion* done);
+void reinit_completion(struct completion* done);
+
+// complete() lets one waiter through, complete_all() every one until reinit_completion()
+void complete(struct completion* done);
+void complete_all(struct completion* done);
+
+int wait_for_completion_timeout(struct completion* done, uint64_t ns);
+int wait_for_completion(struct completion* done);
+
+#endif
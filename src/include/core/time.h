@@ -0,0 +1,27 @@
+#ifndef _TIME_H
+#define _TIME_H
+
+#include <stdint.h>
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+#define NSEC_PER_SEC  1000000000u
+#define NSEC_PER_USEC 1000u
+
+// Layout shared with userland, see clib/include/time.h
+struct timespec {
+	int32_t tv_sec;
+	int32_t tv_nsec;
+};
+
+int time_init();
+uint8_t time_has_clocksource();
+
+// Nanoseconds since boot and since the epoch, 0 without a clocksource
+uint64_t time_monotonic_ns();
+uint64_t time_realtime_ns();
+
+void time_ns_to_timespec(uint64_t ns, struct timespec* ts);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <lib/list.h>
+#include <stdint.h>
+
+#define TIMER_NONE 0xFFFFFFFF // timer_next_us() with nothing pending
+
+struct timer_list;
+typedef void (*timer_fn_t)(struct timer_list* timer);
+
+struct timer_list {
+	struct list_head entry; // Points to itself while not pending
+	uint64_t expires; // Wheel tick, 2^TIMER_TICK_SHIFT ns each
+	timer_fn_t function;
+	void* data;
+	uint16_t slot;
+};
+
+void timer_init();
+
+void timer_setup(struct timer_list* timer, timer_fn_t function, void* data);
+
+// Queued again if already pending, the callback runs once expires is reached
+void timer_add(struct timer_list* timer, uint64_t expires);
+void timer_add_ns(struct timer_list* timer, uint64_t ns);
+
+// 1 if the timer was pending, its callback will not run
+uint8_t timer_cancel(struct timer_list* timer);
+
+static inline uint8_t timer_pending(const struct timer_list* timer){
+	return timer->entry.next != &timer->entry;
+}
+
+// Current task off the CPU for at least ns, must not be the idle task
+void timer_sleep_ns(uint64_t ns);
+
+// Clock interrupt side, expired callbacks and the next deadline
+void timer_run();
+uint32_t timer_next_us();
+
+#endif
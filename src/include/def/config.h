@@ -9,7 +9,6 @@
 
 #define TOTAL_GDT_SEGMENTS 6
 #define TOTAL_INTERRUPTS 256
-#define TIMER_FREQUENCY 20
 
 #define SYSCALLS_MAX 32
 
@@ -19,25 +18,60 @@
 
 #define _TEMP_PAGE_DIRECTORY_ADDRESS 0x02000000
 
-#define HEAP_SIZE_BYTES MiB(40)
+// The heap is sized at boot from the E820 map, between HEAP_SIZE_MIN and HEAP_SIZE_MAX
+#define HEAP_SIZE_DEFAULT MiB(40) // No memory map from the BIOS
+#define HEAP_SIZE_MIN MiB(24) // Keeps the boot page directory inside the heap window
+#define HEAP_SIZE_MAX MiB(208)
 #define HEAP_BLOCK_SIZE 4096
 
 #define HEAP_PHYS_BASE 0x01000000
-#define HEAP_PHYS_END  (HEAP_PHYS_BASE + HEAP_SIZE_BYTES)
-
 #define HEAP_VIRT_BASE 0xC2000000
-#define HEAP_VIRT_END  (HEAP_VIRT_BASE + HEAP_SIZE_BYTES)
 
-#define HEAP_TABLE_PHYS_BASE 0x00007E00
-#define HEAP_TABLE_PHYS_END  (HEAP_TABLE_PHYS_BASE + (HEAP_SIZE_BYTES / HEAP_BLOCK_SIZE))
+#define HEAP_TABLE_MAX_SIZE (HEAP_SIZE_MAX / HEAP_BLOCK_SIZE)
 
-#define HEAP_TABLE_VIRT_BASE \
-	(HEAP_VIRT_BASE - (HEAP_TABLE_PHYS_END - HEAP_TABLE_PHYS_BASE))
+#define HEAP_TABLE_PHYS_BASE 0x00010000
+#define HEAP_TABLE_VIRT_BASE (HEAP_VIRT_BASE - HEAP_TABLE_MAX_SIZE)
 
-#define HEAP_TABLE_VIRT_END (HEAP_TABLE_VIRT_BASE + (HEAP_SIZE_BYTES / HEAP_BLOCK_SIZE))
+// Movable blocks the idle task slides per compaction step
+#define HEAP_COMPACT_IDLE_BLOCKS 16
 
 #define KERNEL_FB_VIRT_BASE 0xD0000000
 
+// Contiguous pool for device DMA, reserved at boot below the 16 MiB ISA limit
+#define DMA_PHYS_BASE 0x00E00000
+#define DMA_VIRT_BASE 0xD8000000
+#define DMA_POOL_SIZE MiB(1)
+
+// Local APIC registers, one uncached page
+#define LAPIC_VIRT_BASE 0xD8100000
+
+// vmalloc(), virtually contiguous kernel buffers built from single frames
+#define VMALLOC_VIRT_BASE 0xE0000000
+#define VMALLOC_VIRT_END  0xF0000000
+
+// Range unmaps invlpg up to this many pages, past it they reload CR3 once
+#define TLB_INVLPG_THRESHOLD 32
+
+// Zeroed frames kept ready for new page tables, refilled by the idle task
+#define PGTABLE_POOL_SIZE 32
+
+// Pre-zeroed frames for alloc_zeroed_page(), the idle task refills from LOW up to HIGH
+#define ZERO_POOL_LOW 16
+#define ZERO_POOL_HIGH 64
+
+// Preallocated on the root volume, one contiguous run of clusters
+#define SWAP_FILE_PATH "/swap"
+
+// Frames swap_reclaim() frees when an allocation fails
+#define SWAP_RECLAIM_BATCH 8
+
+// Temporary kernel mappings of physical frames
+#define KMAP_VIRT_BASE 0xCFC00000
+#define KMAP_SLOTS 32
+
+// Installed RAM assumed when the BIOS gives no memory map (qemu default)
+#define PHYS_MEMORY_DEFAULT_END MiB(128)
+
 #define KERNEL_STACK_SIZE KiB(512)
 #define KERNEL_STACK_PHYS_TOP 0x00200000
 #define KERNEL_STACK_PHYS_BOTTOM (KERNEL_STACK_PHYS_TOP - KERNEL_STACK_SIZE)
@@ -64,15 +98,27 @@
 #define PROC_ARG_MAX 32
 #define PROC_FD_MAX 16
 
+/*Scheduler*/
+#define SCHED_PRIORITY_LEVELS 8 // Run queues, at most 32 for the ready bitmap
+#define SCHED_PRIORITY_MAX (SCHED_PRIORITY_LEVELS - 1)
+#define SCHED_PRIORITY_DEFAULT 4
+#define SCHED_SLICE_US 10000 // Time slice of the top level, every level below gets one more
+#define SCHED_BOOST_US 1000000 // Of busy time, then demoted tasks go back to their base priority
+
+// Timer wheel granularity, 2^20 ns is about a millisecond
+#define TIMER_TICK_SHIFT 20
+
 // Process Stack
 #define PROC_USER_STACK_VIRUTAL_TOP 0x3FF000
 #define PROC_USER_STACK_SIZE 8192
 #define PROC_USER_STACK_VIRUTAL_BUTTOM (PROC_USER_STACK_VIRUTAL_TOP - PROC_USER_STACK_SIZE)
 
-#define PROC_KERNEL_STACK_VIRTUAL_TOP 0xC1100000
-#define PROC_KERNEL_STACK_SIZE 4096
-#define PROC_KERNEL_STACK_VIRTUAL_BUTTOM (PROC_KERNEL_STACK_VIRTUAL_TOP - PROC_KERNEL_STACK_SIZE)
+// Per task, allocated from the kernel heap so it stays mapped across CR3 switches
+#define PROC_KERNEL_STACK_SIZE 8192
 
 #define PROC_VIRTUAL_ADDRESS 0x400000
 
+// Anonymous mmap() area, the brk heap grows below it
+#define PROC_MMAP_VIRTUAL_BASE 0x40000000
+
 #endif
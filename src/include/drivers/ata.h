@@ -1,10 +1,10 @@
 #ifndef _ATA_LBA_H
 #define _ATA_LBA_H
 
+#include <core/sched/wait.h>
 #include <device.h>
 #include <stdint.h>
 
-struct TaskQueue;
 struct ATAChannel;
 
 struct ATADevice {
@@ -21,10 +21,9 @@ struct ATADevice {
 	uint16_t UDMAmodes;
 	uint64_t addressableSectors;
 
-	volatile char irqTriggered;
+	struct completion irqDone; // Reset when a command is issued
 
 	struct ATAChannel* channel;
-	struct TaskQueue sleepQueue;
 };
 
 struct ATAChannel{
@@ -32,6 +31,10 @@ struct ATAChannel{
 	uint16_t ctrlBase;  // 0x3F6 or 0x376
 	struct ATADevice* active;
 	struct ATADevice devices[2];
+
+	// Held for a whole command, both drives share the registers and the irq
+	uint8_t busy;
+	struct wait_queue_head idle;
 };
 
 void ata_init();
@@ -1,6 +1,8 @@
 #ifndef _KEYBOARD_H
 #define _KEYBOARD_H
 
+#include <stdint.h>
+
 typedef struct {
     char shift;
     char ctrl;
@@ -16,4 +18,7 @@ void keyboard_init();
 void keyboard_set_callback(keyboard_callback_t callback);
 kb_state_t* keyboard_get_state();
 
+// Blocks until a key is typed, then takes up to size of them
+int keyboard_read(char* buffer, uint32_t size);
+
 #endif
@@ -4,6 +4,7 @@
 #include <core/process.h>
 #include <fs/vfs.h>
 #include <mmu.h>
+#include <memory/arena.h>
 #include <stdint.h>
 
 #define BINPRM_BUFF_SIZE 256
@@ -27,6 +28,8 @@ struct binprm{
 
     struct mm_struct* mm;
 
+	struct arena* arena; // Owns the binprm and its strings, released by bprm_free()
+
 	char buff[BINPRM_BUFF_SIZE];
 }__attribute__((packed));
 
@@ -2,6 +2,7 @@
 #define _VIRTUAL_FILE_SYSTEM_H
 
 #include <memory/kheap.h>
+#include <memory/slab.h>
 #include <blkdev.h>
 #include <stdint.h>
 #include <stat.h>
@@ -31,6 +32,7 @@ struct file {
     struct inode *inode;
     uint32_t pos;
     uint32_t flags;
+    uint32_t count; // References, vfs_close() releases the last one
     void *private_data;
 
     struct file_operations *f_op;
@@ -46,6 +48,13 @@ struct stat {
     uint32_t ctime;
 };
 
+// Where a file range lives on its block device
+struct file_extent {
+    struct blkdev *bdev;
+    uint64_t start; // Byte offset on the device
+    uint32_t length; // Contiguous bytes from start
+};
+
 struct file_operations {
     int (*read)(struct file *file, void *buffer, uint32_t count);
     int (*write)(struct file *file, const void *buffer, uint32_t count);
@@ -53,6 +62,7 @@ struct file_operations {
 	int (*open) (struct inode *ino, struct file *file);
     int (*close)(struct file *file);
 	int (*release) (struct inode *ino, struct file *file);
+    int (*bmap)(struct file *file, uint32_t offset, struct file_extent *extent);
 };
 
 struct inode_operations {
@@ -88,6 +98,8 @@ struct mount {
 extern struct inode* vfs_root_node;
 extern struct mount* mnt_root;
 
+extern struct kmem_cache inode_cache;
+
 int vfs_mount(struct blkdev *device, const char *mountpoint, const char *filesystemtype);
 int vfs_umount(const char *mountpoint);
 
@@ -100,9 +112,11 @@ int vfs_mkdir(const char *restrict path);
 int vfs_rmdir(const char *restrict path);
 
 int vfs_read(struct file *file, void *buffer, uint32_t size);
+int vfs_pread(struct file *file, void *buffer, uint32_t size, uint32_t offset);
 int vfs_lseek(struct file *file, int offset, int whence);
 int vfs_write(struct file *file, const void *buffer, uint32_t size);
 int vfs_close(struct file *file);
+int vfs_bmap(struct file *file, uint32_t offset, struct file_extent *extent);
 int vfs_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 
 int vfs_getattr(const char *restrict path, struct stat *restrict statbuf);
@@ -110,11 +124,16 @@ int vfs_getattr(const char *restrict path, struct stat *restrict statbuf);
 int vfs_register_filesystem(struct filesystem* fs);
 int vfs_unregister_filesystem(struct filesystem* fs);
 
+static inline struct file* get_file(struct file *file) {
+    file->count++;
+    return file;
+}
+
 static inline void inode_dispose(struct inode *ino) {
     if (ino->private_data)
         kfree(ino->private_data);
 
-    kfree(ino);
+    kmem_cache_free(&inode_cache, ino);
 }
 
 int kernel_exec(const char* pathname, const char* argv[], const char* envp[]);
@@ -0,0 +1,28 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_CHUNK_DEFAULT 4096
+#define ARENA_ALIGN 8
+
+struct arena_chunk;
+
+// Bump allocator for allocations that die together, nothing is freed on its own
+struct arena {
+	struct arena_chunk* head; // Allocations come from here
+	struct arena_chunk* first; // Holds the arena itself, kept by arena_reset()
+	size_t chunkSize;
+};
+
+struct arena* arena_create(size_t chunkSize);
+void* arena_alloc(struct arena* arena, size_t size);
+void* arena_zalloc(struct arena* arena, size_t size);
+char* arena_strdup(struct arena* arena, const char* str);
+
+// Drop every allocation, O(chunks)
+void arena_reset(struct arena* arena);
+void arena_destroy(struct arena* arena);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef _DMA_H
+#define _DMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DMA_LIMIT_ISA 0x01000000 // 24 bit ISA DMA
+#define DMA_LIMIT_32  0xFFFFFFFF
+
+#define DMA_BOUNDARY_64K 0x10000
+
+// Physically contiguous, aligned to align and not crossing a multiple of boundary (0 for none).
+// Returns the kernel address, the bus address goes to physicalAddr.
+void* dma_alloc(size_t size, uint32_t align, uint32_t boundary, uintptr_t* physicalAddr);
+void dma_free(void* virtualAddr);
+
+// Device view of a caller buffer, a pool copy when the buffer does not meet the constraints
+struct DmaBounce {
+	void* data;
+	void* buffer; // data itself or the bounce copy
+	uintptr_t physicalAddr;
+	size_t size;
+	uint8_t bounced;
+};
+
+int dma_bounce_map(struct DmaBounce* bounce, void* data, size_t size, uint32_t boundary, uintptr_t limit, uint8_t toDevice);
+void dma_bounce_unmap(struct DmaBounce* bounce, uint8_t fromDevice);
+
+#endif
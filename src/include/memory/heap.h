@@ -4,20 +4,67 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#define HEAP_BUCKETS 32
+#define HEAP_NIL 0xFFFFFFFF
+
 struct HeapTable{
 	uint8_t* blockEntries;
 	size_t total;
 }__attribute__((packed));
 
+struct HeapHandle;
+
+// Free extent tag, one slot per block.
+// The head and the tail block of a free extent both hold its size,
+// the head also links the extent into its size bucket.
+// The head block of a movable allocation points back to its handle instead.
+struct HeapExtent{
+	uint32_t size;
+	union{
+		struct{
+			uint32_t next;
+			uint32_t prev;
+		}__attribute__((packed));
+		struct HeapHandle* handle;
+	};
+}__attribute__((packed));
+
+// Movable allocation, compaction may change ptr unless it is pinned
+struct HeapHandle{
+	void* ptr;
+	uint32_t blocks;
+	uint32_t pins;
+};
+
 struct Heap{
 	struct HeapTable* table;
 	void* startAddress;
+
+	struct HeapExtent* extents;
+	uint32_t buckets[HEAP_BUCKETS]; // bucket i holds extents of [2^i, 2^(i+1)) blocks
+	uint32_t bucketMask;
+	uint32_t freeBlocks;
+	uint8_t compactPending; // Something was freed since the last full compaction pass
 }__attribute__((packed));
 
+struct HeapStats{
+	uint32_t totalBlocks;
+	uint32_t usedBlocks;
+	uint32_t freeBlocks;
+	uint32_t freeExtents;
+	uint32_t largestFree; // Blocks in the biggest free extent
+	uint32_t fragmentation; // 0-100
+};
+
 int create_heap(struct Heap* heap, struct HeapTable* table, void* startPtr, void* end);
 void* hmalloc(struct Heap* heap, size_t size);
 void* hcalloc(struct Heap* heap, size_t nmemb, size_t size);
 void* hrealloc(struct Heap* heap, void* ptr, size_t new_size);
 void hfree(struct Heap* heap, void* ptr);
+void heap_stats(struct Heap* heap, struct HeapStats* stats);
+
+int hmalloc_movable(struct Heap* heap, struct HeapHandle* handle, size_t size);
+void hfree_movable(struct Heap* heap, struct HeapHandle* handle);
+uint32_t hcompact(struct Heap* heap, uint32_t maxBlocks);
 
 #endif
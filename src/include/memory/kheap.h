@@ -1,17 +1,50 @@
 #ifndef _KERNEL_HEAP_H
 #define _KERNEL_HEAP_H
 
+#include <memory/heap.h>
 #include <lib/mem.h>
+#include <stdint.h>
 #include <stddef.h>
 
+#define KHEAP_COMPACT_ALL 0xFFFFFFFF
+
+struct CompactStats{
+	uint32_t runs;
+	uint32_t blocksMoved;
+	uint32_t fragmentationBefore; // Last run
+	uint32_t fragmentationAfter;
+};
+
 int init_kheap();
-void* kmalloc(size_t size);
+void* (kmalloc)(size_t size);
+void* kmalloc_site(size_t size, const char* file, int line);
 void* kcalloc(size_t nmemb, size_t size);
 void* krealloc(void *ptr, size_t newSize);
 void kfree(void* ptr);
 
-static inline void* kzalloc(size_t size) {
-	void* ptr = kmalloc(size);
+size_t kheap_size();
+
+void kheap_stats(struct HeapStats* stats);
+
+// Whole blocks that compaction may move, reach them through a pin
+struct HeapHandle* kmalloc_movable(size_t size);
+void kfree_movable(struct HeapHandle* handle);
+
+uint32_t kheap_compact(uint32_t maxBlocks);
+void kheap_compact_stats(struct CompactStats* stats);
+
+// The pointer is only stable while the handle is pinned
+static inline void* kmovable_pin(struct HeapHandle* handle) {
+	handle->pins++;
+	return handle->ptr;
+}
+
+static inline void kmovable_unpin(struct HeapHandle* handle) {
+	handle->pins--;
+}
+
+static inline void* kzalloc_site(size_t size, const char* file, int line) {
+	void* ptr = kmalloc_site(size, file, line);
 	if (ptr) {
 		memset(ptr, 0x0, size);
 	}
@@ -19,4 +52,15 @@ static inline void* kzalloc(size_t size) {
 	return ptr;
 }
 
+static inline void* (kzalloc)(size_t size) {
+	return kzalloc_site(size, 0x0, 0);
+}
+
+// Build with EXTRA_CFLAGS=-DMEMSTAT_CALLSITES to charge every
+// kmalloc/kzalloc to the file and line that made it
+#ifdef MEMSTAT_CALLSITES
+#define kmalloc(size) kmalloc_site((size), __FILE__, __LINE__)
+#define kzalloc(size) kzalloc_site((size), __FILE__, __LINE__)
+#endif
+
 #endif
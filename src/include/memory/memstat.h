@@ -0,0 +1,53 @@
+#ifndef _MEMSTAT_H
+#define _MEMSTAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MEMSTAT_HIST_BUCKETS 16 // kmalloc sizes up to 16 B, 32 B, ..., 256 KiB and bigger
+#define MEMSTAT_SITES_MAX 64
+
+#define MEMSTAT_DUMP 0x1 // sys_memstat also writes the report to the serial port
+
+// Layout shared with userland, see clib/include/sys/memstat.h
+struct memstat {
+	uint32_t heapBlockSize;
+	uint32_t heapTotalBlocks;
+	uint32_t heapUsedBlocks;
+	uint32_t heapFreeBlocks;
+	uint32_t heapFreeExtents;
+	uint32_t heapLargestFree;
+	uint32_t heapFragmentation; // 0-100
+
+	// Compaction of movable blocks, fragmentation around the last run
+	uint32_t compactions;
+	uint32_t compactedBlocks;
+	uint32_t compactFragBefore;
+	uint32_t compactFragAfter;
+
+	uint32_t slabs;
+	uint32_t slabObjects;
+
+	uint32_t totalPages;
+	uint32_t freePages;
+
+	// Page sized slots of the swap file
+	uint32_t swapSlots;
+	uint32_t swapUsed;
+
+	// Calling process
+	uint32_t pageTables;
+	uint32_t residentPages;
+
+	uint32_t sizeHistogram[MEMSTAT_HIST_BUCKETS];
+};
+
+struct Process;
+
+void memstat_record(size_t size);
+void memstat_record_site(const char* file, int line, size_t size);
+
+void memstat_collect(struct memstat* stats, struct Process* process);
+void memstat_dump();
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _PAGE_ALLOC_H
+#define _PAGE_ALLOC_H
+
+#include <memory/paging.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define PAGE_ORDER_MAX 10 // 2^10 frames, 4 MiB
+#define PAGE_ORDERS (PAGE_ORDER_MAX + 1)
+
+int page_alloc_init();
+int page_alloc_add_range(uintptr_t start, uintptr_t end);
+
+// Physical addresses, 0x0 on failure
+void* alloc_pages(uint32_t order);
+void free_pages(void* physicalAddr, uint32_t order);
+
+// Shared blocks, free_pages() drops one reference
+void page_ref(void* physicalAddr);
+uint32_t page_ref_count(void* physicalAddr);
+
+uint32_t page_alloc_free_count();
+uint32_t page_alloc_total_count();
+
+// Cleared frame from the pre-zeroed pool, zeroed inline when the pool is empty
+void* alloc_zeroed_page();
+uint32_t zero_pool_refill(uint32_t pages);
+uint32_t zero_pool_count();
+
+static inline void* alloc_page(){
+	return alloc_pages(0);
+}
+
+static inline void free_page(void* physicalAddr){
+	free_pages(physicalAddr, 0);
+}
+
+// Smallest order whose block holds size bytes
+static inline uint32_t page_order(size_t size){
+	uint32_t order = 0;
+	while(((size_t)PAGING_PAGE_SIZE << order) < size){
+		order++;
+	}
+
+	return order;
+}
+
+#endif
@@ -5,9 +5,15 @@
 
 #define PAGING_TOTAL_ENTRIES_PER_TABLE 1024
 #define PAGING_PAGE_SIZE 4096
+#define PAGING_LARGE_PAGE_SIZE 0x400000 // One directory entry with PSE
 
 // Flags
-#define FPAGING_PCD 0x16
+#define FPAGING_SWAP 0x200 // Available bit, a non-present PTE holding a swap slot
+#define FPAGING_G   0x100 // Global, survives CR3 reloads (does not fit the uint8_t flag arguments)
+#define FPAGING_PS  0x80 // Directory entry maps a 4 MiB page
+#define FPAGING_D   0x40 // Set by the CPU on write
+#define FPAGING_A   0x20 // Set by the CPU on access
+#define FPAGING_PCD 0x10
 #define FPAGING_PWT 0x8
 #define FPAGING_US  0x4
 #define FPAGING_RW  0x2
@@ -15,13 +21,26 @@
 
 // Mask
 #define PAGE_MASK 0xFFFFF000
+#define LARGE_PAGE_MASK 0xFFC00000
 #define FLAGS_MASK 0x00000FFF
 
 typedef uint32_t PagingTable;
 
+#define PAGING_USER_TABLES 768 // Directory entries below KERNEL_VIRT_BASE
+#define PAGING_KERNEL_TABLES (PAGING_TOTAL_ENTRIES_PER_TABLE - PAGING_USER_TABLES - 1) // Without the self PDE
+
 struct PagingDirectory {
 	uint32_t* entry;
 	uint32_t tableCount;
+
+	// Present and swapped PTEs of each user table, the table is freed when it drops to 0
+	uint16_t entryCount[PAGING_USER_TABLES];
+};
+
+// Deferred invalidation for range updates, see paging_tlb_batch_add()
+struct TlbBatch {
+	uint32_t pages;
+	uint8_t global; // A kernel half entry changed
 };
 
 struct PagingDirectory* paging_new_directory();
@@ -33,10 +52,39 @@ void paging_enable();
 int paging_map(void* virtualAddr, void* physicalAddr, uint8_t flags);
 int paging_map_range(int count, void* virtualAddr, void* physicalAddr, uint8_t flags);
 
+int paging_remap(void* virtualAddr, void* physicalAddr, uint8_t flags);
+
 int paging_unmap(void* virtualAddr);
 int paging_unmap_range(int count, void* virtualAddr);
 
 void* paging_translate(void* virtualAddr);
+PagingTable* paging_pte(void* virtualAddr);
+
+// CR3 reload, global kernel entries stay cached
+void paging_flush_tlb();
+// Every entry including global ones, for changes to kernel mappings
+void paging_flush_tlb_all();
+
+void paging_tlb_batch_add(struct TlbBatch* batch, void* virtualAddr);
+void paging_tlb_batch_finish(struct TlbBatch* batch);
+void paging_set_flush_threshold(uint32_t pages);
+
+// The slot sits where the frame address would be, see memory/swap.c
+static inline uint8_t paging_is_swap_entry(PagingTable entry){
+	return !(entry & FPAGING_P) && (entry & FPAGING_SWAP);
+}
+
+static inline PagingTable paging_swap_entry(uint32_t slot){
+	return (slot << 12) | FPAGING_SWAP;
+}
+
+static inline uint32_t paging_swap_slot(PagingTable entry){
+	return entry >> 12;
+}
+
+static inline void paging_invlpg(void* virtualAddr){
+	__asm__ volatile("invlpg (%0)" : : "r"(virtualAddr) : "memory");
+}
 
 static inline void* paging_align_to_lower(void* addr){
     return (void*)((uintptr_t)addr & ~(PAGING_PAGE_SIZE - 1));
@@ -0,0 +1,16 @@
+#ifndef _PGTABLE_H
+#define _PGTABLE_H
+
+#include <stdint.h>
+
+// Zeroed physical frame for a page table, 0x0 when out of memory
+void* pgtable_alloc();
+
+// Give back a table whose entries are all clear
+void pgtable_free(void* physicalAddr);
+
+// Zero up to pages frames into the pool, returns how many were added
+uint32_t pgtable_pool_refill(uint32_t pages);
+uint32_t pgtable_pool_count();
+
+#endif
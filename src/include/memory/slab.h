@@ -0,0 +1,49 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <def/config.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define SLAB_MIN_SIZE 16
+#define SLAB_MAX_SIZE 2048
+#define SLAB_SIZE_CLASSES 8 // 16, 32, 64, ..., 2048
+
+#define SLAB_ALIGN 8
+
+struct slab;
+
+struct kmem_cache {
+	const char* name;
+	uint32_t objectSize;
+	uint32_t objectsPerSlab;
+
+	struct slab* partial;
+	struct slab* full;
+	struct slab* empty;
+
+	uint32_t totalSlabs;
+	uint32_t activeObjects;
+};
+
+// Static cache definition, the geometry is computed on the first grow
+#define KMEM_CACHE_INIT(cname, size) \
+	{ .name = cname, .objectSize = size }
+
+void* kmem_cache_alloc(struct kmem_cache* cache);
+void* kmem_cache_zalloc(struct kmem_cache* cache);
+void kmem_cache_free(struct kmem_cache* cache, void* obj);
+void kmem_cache_shrink(struct kmem_cache* cache);
+
+// Generic power-of-two size classes used by kmalloc
+void* kmem_alloc_size(size_t size);
+void kmem_free(void* obj);
+size_t kmem_object_size(void* obj);
+void kmem_size_stats(uint32_t* slabs, uint32_t* objects);
+
+static inline uint8_t kmem_is_slab_object(void* ptr){
+	// Slab objects are never block aligned, the slab header lives at the page start
+	return ((uintptr_t)ptr & (HEAP_BLOCK_SIZE - 1)) != 0;
+}
+
+#endif
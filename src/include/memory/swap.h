@@ -0,0 +1,23 @@
+#ifndef _SWAP_H
+#define _SWAP_H
+
+#include <stdint.h>
+
+struct mem_region;
+
+// The file must be contiguous on its volume, see tools/fs/fat
+int swap_on(const char* path);
+
+// Frames taken from cold user pages, at most pages
+uint32_t swap_reclaim(uint32_t pages);
+
+// Fault page of region back in, the loaded directory must hold its swap entry
+int swap_in(struct mem_region* region, void* page);
+
+// Slots are reference counted, fork() shares them like frames
+void swap_dup(uint32_t slot);
+void swap_free(uint32_t slot);
+
+void swap_stats(uint32_t* slots, uint32_t* used);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _VMA_TREE_H
+#define _VMA_TREE_H
+
+#include <mmu.h>
+#include <stdint.h>
+
+void vma_tree_insert(struct mm_struct* mm, struct mem_region* region);
+void vma_tree_remove(struct mm_struct* mm, struct mem_region* region);
+void vma_tree_update(struct mm_struct* mm, struct mem_region* region); // After its end moved
+
+struct mem_region* vma_tree_lookup(struct mm_struct* mm, uintptr_t addr);
+struct mem_region* vma_tree_first_after(struct mm_struct* mm, uintptr_t addr); // First region ending above addr
+uintptr_t vma_tree_find_gap(struct mm_struct* mm, uintptr_t low, uint32_t size);
+
+struct mem_region* vma_first(struct mm_struct* mm);
+struct mem_region* vma_next(struct mem_region* region);
+struct mem_region* vma_prev(struct mem_region* region);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef _VMALLOC_H
+#define _VMALLOC_H
+
+#include <stddef.h>
+
+// Page granular, backed by frames that need not be physically contiguous
+void* vmalloc(size_t size);
+void* vzalloc(size_t size);
+void vfree(void* ptr);
+
+#endif
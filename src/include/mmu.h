@@ -11,16 +11,23 @@
 #define PROT_WRITE 0x2
 #define PROT_EXEC  0x4
 
-#define MAP_POPULATE  0x0
 #define MAP_FIXED     0x1
 #define MAP_PRIVATE   0x2
 #define MAP_ANONYMOUS 0x4
+#define MAP_POPULATE  0x8 // Fault the pages in before returning
 
 #define SELF_PDE_INDEX 1023
 
 #define VIRT_PDIR ((uint32_t*)0xFFFFF000)
 #define VIRT_PTBL(i) ((uint32_t*)(0xFFC00000 + (i) * PAGING_PAGE_SIZE))
 
+// What backs the pages of a region, frames are only allocated on fault
+#define VMA_ANONYMOUS 0x0 // Stacks and heaps, zero filled
+#define VMA_ZERO      0x1 // Zero filled data (BSS)
+#define VMA_FILE      0x2 // Read from file, zero filled past fileSize
+
+struct file;
+
 struct mem_region {
 	void* physBaseAddress;
     void* virtualBaseAddress;
@@ -30,14 +37,37 @@ struct mem_region {
 	uint8_t flags;
 
 	uint8_t isPrivite;
-    struct mem_region* next;
+	uint8_t type;
+
+	struct file* file;
+	uint32_t fileOffset;
+	uint32_t fileSize;
+
+	// Interval tree links and subtree values, see memory/vma_tree.c
+	struct mem_region* left;
+	struct mem_region* right;
+	struct mem_region* parent;
+	uintptr_t maxEnd;
+	uint32_t gapBefore; // Free space between the previous region and this one
+	uint32_t maxGap;
+	int8_t height;
 }__attribute__((packed));
 
 struct mm_struct{
-    struct mem_region* regions;
-    void* mmapBase; // Next free space
+    struct mem_region* regions; // Interval tree root
+    struct mem_region* lookupCache; // Last region found by vma_lookup()
+    uint32_t regionCount;
+
+    void* mmapBase; // Anonymous mappings are placed from here up
+
+    uintptr_t brkStart; // Heap, right after the program image
+    uintptr_t brk;
+
+    struct file* exeFile; // Backs the VMA_FILE regions
 
     struct PagingDirectory* pageDirectory;
+
+    uint32_t generation; // Unique per mm, a freed one may come back at the same address
 };
 
 extern struct PagingDirectory* _currentDirectory;
@@ -49,18 +79,35 @@ int mmu_page_switch(struct PagingDirectory* directory);
 int mmu_destroy_page(struct PagingDirectory* directory);
 int mmu_map_pages(void* virtualAddr, void* physicalAddr, uint32_t size, uint8_t flags);
 int mmu_unmap_pages(void* virtualStart, uint32_t size);
+int mmu_alloc_pages(void* virtualAddr, uint32_t size, uint8_t flags);
+int mmu_release_pages(struct PagingDirectory* directory, void* virtualStart, uint32_t size);
+int mmu_protect_pages(struct PagingDirectory* directory, void* virtualStart, uint32_t size, uint8_t flags);
+int mmu_share_pages(struct PagingDirectory* dst, struct PagingDirectory* src, void* virtualStart, uint32_t size, uint8_t isPrivate);
 void* mmu_translate(void* virt);
 uint8_t mmu_user_pointer_valid(void* ptr);
 uint8_t mmu_user_pointer_valid_range(const void* userPtr, size_t size);
 
 void mmu_copy_kernel_to_directory(struct PagingDirectory* directory);
+void mmu_directory_stats(struct PagingDirectory* directory, uint32_t* tables, uint32_t* residentPages);
+
+struct mm_struct* mm_alloc();
 
 struct mem_region* vma_lookup(struct mm_struct* mm, void* virtualAddr);
 int vma_add(struct mm_struct* mm, void* virtualAddr, void* physicalAddr, uint32_t size, uint8_t flags, uint8_t isPrivate);
+int vma_add_file(struct mm_struct* mm, void* virtualAddr, uint32_t size, uint8_t flags, struct file* file, uint32_t offset, uint32_t fileSize);
+int vma_fault(struct mm_struct* mm, struct mem_region* region, void* virtualAddr);
+int vma_populate(struct mm_struct* mm, void* virtualAddr, uint32_t size);
+int vma_fork(struct mm_struct* dst, struct mm_struct* src);
 int vma_remove(struct mm_struct* mm, void* virtualAddr, uint32_t size);
+int vma_protect(struct mm_struct* mm, void* virtualAddr, uint32_t size, uint8_t flags);
+uint8_t vma_range_free(struct mm_struct* mm, void* virtualAddr, uint32_t size);
+void* vma_find_free(struct mm_struct* mm, void* virtualAddr, uint32_t size);
 int vma_clean(struct mm_struct* mm);
 int vma_destroy(struct mm_struct* mm);
 
 void* phys_to_virt(void* physicalAddr);
 
+void* kmap(void* physicalAddr);
+void kunmap(void* virtualAddr);
+
 #endif
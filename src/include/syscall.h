@@ -42,10 +42,10 @@
     __SYSCALL_DEFINEx(x, sname, __VA_ARGS__)
 
 #define SYSCALL_DEFINE0(sname) \
-    asmlinkage long sys##name(void)                         \
-        __attribute__((alias(stringfy(__se_sys##name))));   \
-    asmlinkage long __se_sys##name(void);                   \
-    asmlinkage long __se_sys##name(void)
+    asmlinkage long sys_##sname(void)                         \
+        __attribute__((alias(stringfy(__se_sys_##sname))));   \
+    asmlinkage long __se_sys_##sname(void);                   \
+    asmlinkage long __se_sys_##sname(void)
 
 #define SYSCALL_DEFINE1(name, ...) SYSCALL_DEFINEx(1, _##name, __VA_ARGS__)
 #define SYSCALL_DEFINE2(name, ...) SYSCALL_DEFINEx(2, _##name, __VA_ARGS__)
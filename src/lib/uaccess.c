@@ -3,14 +3,54 @@
 #include <core/sched.h>
 #include <def/status.h>
 #include <def/config.h>
+#include <core/process.h>
 #include <mmu.h>
 
+// Every page of the source must sit in a region, the fault handler backs it
 int copy_from_user(void* kdst, const void* usrc, uint64_t size){
-   return NOT_IMPLEMENTED;
+    struct Task* task = pcb_current();
+    if(!task || !task->process || !task->process->mm){
+        return INVALID_STATE;
+    }
+
+    uintptr_t start = (uintptr_t)usrc;
+    if(!usrc || size > KERNEL_VIRT_BASE || start + (uint32_t)size < start || start + (uint32_t)size > KERNEL_VIRT_BASE){
+        return INVALID_ARG;
+    }
+
+    for(uintptr_t addr = start & ~(PAGING_PAGE_SIZE - 1); addr < start + (uint32_t)size; addr += PAGING_PAGE_SIZE){
+        if(!vma_lookup(task->process->mm, (void*)addr)){
+            return INVALID_ARG;
+        }
+    }
+
+    memcpy(kdst, usrc, (uint32_t)size);
+
+    return SUCCESS;
 }
 
+// Every page of the destination must sit in a writable region, the fault handler backs it
 int copy_to_user(const void* ksrc, void* udst, uint64_t size){
-    return NOT_IMPLEMENTED;
+    struct Task* task = pcb_current();
+    if(!task || !task->process || !task->process->mm){
+        return INVALID_STATE;
+    }
+
+    uintptr_t start = (uintptr_t)udst;
+    if(!udst || size > KERNEL_VIRT_BASE || start + (uint32_t)size < start || start + (uint32_t)size > KERNEL_VIRT_BASE){
+        return INVALID_ARG;
+    }
+
+    for(uintptr_t addr = start & ~(PAGING_PAGE_SIZE - 1); addr < start + (uint32_t)size; addr += PAGING_PAGE_SIZE){
+        struct mem_region* region = vma_lookup(task->process->mm, (void*)addr);
+        if(!region || !(region->flags & FPAGING_RW)){
+            return INVALID_ARG;
+        }
+    }
+
+    memcpy(udst, ksrc, (uint32_t)size);
+
+    return SUCCESS;
 }
 
 int copy_string_from_user(char* kdst, const char* usrc, int len){
@@ -0,0 +1,168 @@
+#include <memory/dma.h>
+#include <memory/paging.h>
+#include <core/kernel.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <lib/mem.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * DMA pool
+ *
+ * DMA_POOL_SIZE bytes at DMA_PHYS_BASE are kept away from the page
+ * allocator at boot and mapped at DMA_VIRT_BASE. The pool sits below
+ * 16 MiB, so its buffers suit ISA and 32 bit bus masters alike.
+ *
+ * Buffers are whole pages, found first-fit in a bitmap. The run length
+ * is stored at the first page so dma_free() only needs the address.
+ */
+
+#define _PAGES (DMA_POOL_SIZE / PAGING_PAGE_SIZE)
+
+static uint32_t _used[_PAGES / 32];
+static uint16_t _runs[_PAGES];
+
+static inline uint8_t _page_used(uint32_t i){
+	return (_used[i / 32] >> (i % 32)) & 1;
+}
+
+static void _mark(uint32_t first, uint32_t count, uint8_t used){
+	for(uint32_t i = first; i < first + count; i++){
+		if(used){
+			_used[i / 32] |= 1u << (i % 32);
+		}else{
+			_used[i / 32] &= ~(1u << (i % 32));
+		}
+	}
+}
+
+static inline uint8_t _crosses(uintptr_t phys, size_t size, uint32_t boundary){
+	return boundary && (phys / boundary) != ((phys + size - 1) / boundary);
+}
+
+void* dma_alloc(size_t size, uint32_t align, uint32_t boundary, uintptr_t* physicalAddr){
+	if(!size || size > DMA_POOL_SIZE || (align & (align - 1)) || (boundary & (boundary - 1))){
+		return 0x0;
+	}
+
+	if(boundary && size > boundary){
+		return 0x0;
+	}
+
+	if(align < PAGING_PAGE_SIZE){
+		align = PAGING_PAGE_SIZE;
+	}
+
+	uint32_t count = (size + PAGING_PAGE_SIZE - 1) / PAGING_PAGE_SIZE;
+	uint32_t step = align / PAGING_PAGE_SIZE;
+
+	for(uint32_t first = 0; first + count <= _PAGES; first += step){
+		uintptr_t phys = DMA_PHYS_BASE + (first * PAGING_PAGE_SIZE);
+		if((phys & (align - 1)) || _crosses(phys, size, boundary)){
+			continue;
+		}
+
+		uint32_t i = 0;
+		while(i < count && !_page_used(first + i)){
+			i++;
+		}
+
+		if(i < count){
+			continue;
+		}
+
+		_mark(first, count, 1);
+		_runs[first] = count;
+
+		if(physicalAddr){
+			*physicalAddr = phys;
+		}
+
+		return (void*)(DMA_VIRT_BASE + (first * PAGING_PAGE_SIZE));
+	}
+
+	return 0x0;
+}
+
+void dma_free(void* virtualAddr){
+	uintptr_t virt = (uintptr_t)virtualAddr;
+	uint32_t first = (virt - DMA_VIRT_BASE) / PAGING_PAGE_SIZE;
+
+	if(virt < DMA_VIRT_BASE || first >= _PAGES || (virt & (PAGING_PAGE_SIZE - 1)) || !_runs[first]){
+		warning("dma_free(): 0x%x is not a DMA buffer\n", virtualAddr);
+		return;
+	}
+
+	_mark(first, _runs[first], 0);
+	_runs[first] = 0;
+}
+
+// Physical address of [data, data + size) if it is contiguous and meets the constraints, 0 otherwise
+static uintptr_t _dma_capable(void* data, size_t size, uint32_t boundary, uintptr_t limit){
+	uintptr_t phys = (uintptr_t)mmu_translate(data);
+	if(!phys){
+		return 0;
+	}
+
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(data) + PAGING_PAGE_SIZE;
+	uintptr_t end = (uintptr_t)data + size;
+
+	for(; virt < end; virt += PAGING_PAGE_SIZE){
+		uintptr_t expected = phys + (virt - (uintptr_t)data);
+		if((uintptr_t)mmu_translate((void*)virt) != expected){
+			return 0;
+		}
+	}
+
+	if(phys + size - 1 > limit || phys + size < phys || _crosses(phys, size, boundary)){
+		return 0;
+	}
+
+	return phys;
+}
+
+int dma_bounce_map(struct DmaBounce* bounce, void* data, size_t size, uint32_t boundary, uintptr_t limit, uint8_t toDevice){
+	if(!bounce || !data || !size){
+		return INVALID_ARG;
+	}
+
+	bounce->data = data;
+	bounce->size = size;
+	bounce->bounced = 0;
+
+	uintptr_t phys = _dma_capable(data, size, boundary, limit);
+	if(phys){
+		bounce->buffer = data;
+		bounce->physicalAddr = phys;
+		return SUCCESS;
+	}
+
+	// The pool always sits below both limits
+	bounce->buffer = dma_alloc(size, 0, boundary, &bounce->physicalAddr);
+	if(!bounce->buffer){
+		return NO_MEMORY;
+	}
+
+	bounce->bounced = 1;
+
+	if(toDevice){
+		memcpy(bounce->buffer, data, size);
+	}
+
+	return SUCCESS;
+}
+
+void dma_bounce_unmap(struct DmaBounce* bounce, uint8_t fromDevice){
+	if(!bounce || !bounce->bounced){
+		return;
+	}
+
+	if(fromDevice){
+		memcpy(bounce->data, bounce->buffer, bounce->size);
+	}
+
+	dma_free(bounce->buffer);
+	bounce->bounced = 0;
+	bounce->buffer = 0x0;
+}
@@ -0,0 +1,137 @@
+#include <memory/arena.h>
+#include <memory/kheap.h>
+#include <lib/mem.h>
+#include <lib/string.h>
+#include <stdint.h>
+
+/*
+ * Arena allocator
+ *
+ * Chunks come from kmalloc and are only ever bumped. The arena header
+ * lives in the first chunk, so creating one is a single allocation and
+ * releasing everything walks the chunk list once. Requests bigger than a
+ * chunk get a chunk of their own.
+ */
+
+struct arena_chunk {
+	struct arena_chunk* next;
+	size_t size;
+	size_t used;
+};
+
+static inline size_t _align(size_t size){
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+#define _CHUNK_HEADER _align(sizeof(struct arena_chunk))
+
+static struct arena_chunk* _chunk_new(size_t size){
+	struct arena_chunk* chunk = (struct arena_chunk*)kmalloc(size);
+	if(!chunk){
+		return 0x0;
+	}
+
+	chunk->next = 0x0;
+	chunk->size = size;
+	chunk->used = _CHUNK_HEADER;
+
+	return chunk;
+}
+
+struct arena* arena_create(size_t chunkSize){
+	if(!chunkSize){
+		chunkSize = ARENA_CHUNK_DEFAULT;
+	}
+
+	if(chunkSize < _CHUNK_HEADER + _align(sizeof(struct arena)) + ARENA_ALIGN){
+		return 0x0;
+	}
+
+	struct arena_chunk* chunk = _chunk_new(chunkSize);
+	if(!chunk){
+		return 0x0;
+	}
+
+	struct arena* arena = (struct arena*)((uint8_t*)chunk + chunk->used);
+	chunk->used += _align(sizeof(struct arena));
+
+	arena->head = chunk;
+	arena->first = chunk;
+	arena->chunkSize = chunkSize;
+
+	return arena;
+}
+
+void* arena_alloc(struct arena* arena, size_t size){
+	if(!arena || !size){
+		return 0x0;
+	}
+
+	size = _align(size);
+
+	struct arena_chunk* chunk = arena->head;
+	if(chunk->size - chunk->used < size){
+		size_t chunkSize = arena->chunkSize;
+		if(size > chunkSize - _CHUNK_HEADER){
+			chunkSize = size + _CHUNK_HEADER;
+		}
+
+		chunk = _chunk_new(chunkSize);
+		if(!chunk){
+			return 0x0;
+		}
+
+		chunk->next = arena->head;
+		arena->head = chunk;
+	}
+
+	void* ptr = (uint8_t*)chunk + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+void* arena_zalloc(struct arena* arena, size_t size){
+	void* ptr = arena_alloc(arena, size);
+	if(ptr){
+		memset(ptr, 0x0, size);
+	}
+
+	return ptr;
+}
+
+char* arena_strdup(struct arena* arena, const char* str){
+	size_t len = strlen(str) + 1;
+
+	char* copy = (char*)arena_alloc(arena, len);
+	if(copy){
+		memcpy(copy, str, len);
+	}
+
+	return copy;
+}
+
+void arena_reset(struct arena* arena){
+	if(!arena){
+		return;
+	}
+
+	struct arena_chunk* chunk = arena->head;
+	while(chunk != arena->first){
+		struct arena_chunk* next = chunk->next;
+		kfree(chunk);
+		chunk = next;
+	}
+
+	arena->head = arena->first;
+	arena->first->used = _CHUNK_HEADER + _align(sizeof(struct arena));
+}
+
+void arena_destroy(struct arena* arena){
+	if(!arena){
+		return;
+	}
+
+	arena_reset(arena);
+	kfree(arena->first);
+}
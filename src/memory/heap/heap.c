@@ -20,8 +20,10 @@
 
 #define _FBLOCK_HAS_NEXT 0x08
 #define _FBLOCK_IS_FIRST 0x04
+#define _FBLOCK_MOVABLE 0x02 // Only on the first block, see hcompact()
 
-uint32_t total_memory_allocated_in_blocks = 0;
+// Extents looked at in the request's own bucket before falling back to a bigger one
+#define _FIT_SEARCH_MAX 8
 
 // Checks if the number of blocks in the heap table matches the actual memory region size
 static uint8_t _validate_table(struct HeapTable *table, void *ptr, void *end)
@@ -56,59 +58,184 @@ static inline uint8_t _get_block_entry_flag(uint8_t entry)
 	return entry & 0x0F;
 }
 
-// Finds a sequence of contiguous free blocks in the heap large
-// enough to satisfy an allocation request
+static inline uint32_t _floor_log2(uint32_t val){
+	return 31 - __builtin_clz(val);
+}
+
+static inline uint32_t _ceil_log2(uint32_t val){
+	return val <= 1 ? 0 : 32 - __builtin_clz(val - 1);
+}
+
+static inline uint8_t _is_block_free(struct Heap *heap, uint32_t block){
+	return _get_block_entry_flag(heap->table->blockEntries[block]) == _FBLOCK_FREE;
+}
+
+/*
+ * Free extent index.
+ *
+ * Free runs of blocks are kept in buckets by floor(log2(size)) and a bitmap marks
+ * the non-empty buckets, so a fit is found with a single bsf instead of a scan of
+ * the whole table. Both ends of a free run carry its size (boundary tags), which
+ * lets hfree merge with its neighbours in O(1).
+ */
+
+static void _extent_insert(struct Heap *heap, uint32_t start, uint32_t size)
+{
+	struct HeapExtent *extents = heap->extents;
+	uint32_t bucket = _floor_log2(size);
+
+	extents[start].size = size;
+	extents[start + size - 1].size = size;
+
+	extents[start].prev = HEAP_NIL;
+	extents[start].next = heap->buckets[bucket];
+
+	if (heap->buckets[bucket] != HEAP_NIL)
+	{
+		extents[heap->buckets[bucket]].prev = start;
+	}
+
+	heap->buckets[bucket] = start;
+	heap->bucketMask |= (1u << bucket);
+	heap->freeBlocks += size;
+}
+
+static void _extent_remove(struct Heap *heap, uint32_t start)
+{
+	struct HeapExtent *extent = &heap->extents[start];
+	uint32_t bucket = _floor_log2(extent->size);
+
+	if (extent->prev != HEAP_NIL)
+	{
+		heap->extents[extent->prev].next = extent->next;
+	}
+	else
+	{
+		heap->buckets[bucket] = extent->next;
+	}
+
+	if (extent->next != HEAP_NIL)
+	{
+		heap->extents[extent->next].prev = extent->prev;
+	}
+
+	if (heap->buckets[bucket] == HEAP_NIL)
+	{
+		heap->bucketMask &= ~(1u << bucket);
+	}
+
+	heap->freeBlocks -= extent->size;
+}
+
+// Finds a run of free blocks large enough to satisfy an allocation request
+// and takes it out of the index, leaving any remainder in it
 static int _get_start_block(struct Heap *heap, uint32_t totalBlocks)
 {
-	struct HeapTable *table = heap->table;
-	size_t consecutiveFreeBlocks = 0;
-	int startIndex = -1;
+	if (totalBlocks == 0 || totalBlocks > heap->freeBlocks)
+	{
+		return NO_MEMORY;
+	}
+
+	uint32_t start = HEAP_NIL;
+	uint32_t minBucket = _ceil_log2(totalBlocks);
 
-	for (size_t i = 0; i < table->total; i++)
+	// Prefer a close fit from the request's own bucket, looking at a bounded
+	// number of extents so big runs are not split needlessly
+	uint32_t i = heap->buckets[_floor_log2(totalBlocks)];
+	for (int tries = 0; i != HEAP_NIL && tries < _FIT_SEARCH_MAX; i = heap->extents[i].next, tries++)
 	{
-		if (_get_block_entry_flag(table->blockEntries[i]) == _FBLOCK_FREE) // Verify if current block is free
+		if (heap->extents[i].size >= totalBlocks)
 		{
-			if (startIndex == -1) // if this is the first block
-				startIndex = i;
+			start = i;
+			break;
+		}
+	}
 
-			consecutiveFreeBlocks++;
+	// Every extent in a bucket >= ceil(log2(n)) fits, take the smallest class
+	uint32_t mask = minBucket < HEAP_BUCKETS ? heap->bucketMask & ~((1u << minBucket) - 1) : 0;
+	if (start == HEAP_NIL && mask)
+	{
+		start = heap->buckets[__builtin_ctz(mask)];
+	}
 
-			if (consecutiveFreeBlocks == totalBlocks)
-			{
-				return startIndex;
-			}
-		}
-		else
+	// Last resort, the rest of the request's own bucket
+	for (; start == HEAP_NIL && i != HEAP_NIL; i = heap->extents[i].next)
+	{
+		if (heap->extents[i].size >= totalBlocks)
 		{
-			consecutiveFreeBlocks = 0;
-			startIndex = -1;
+			start = i;
 		}
 	}
 
-	return NO_MEMORY;
+	if (start == HEAP_NIL)
+	{
+		return NO_MEMORY;
+	}
+
+	uint32_t size = heap->extents[start].size;
+	_extent_remove(heap, start);
+
+	if (size > totalBlocks)
+	{
+		_extent_insert(heap, start + totalBlocks, size - totalBlocks);
+	}
+
+	return start;
 }
 
-static void _set_blocks_free(struct Heap *heap, int startingBlock)
+// Clears an allocation chain and returns the amount of blocks released
+static uint32_t _set_blocks_free(struct Heap *heap, int startingBlock)
 {
 	struct HeapTable *table = heap->table;
+	uint32_t freed = 0;
+
 	for (int i = startingBlock; i < table->total; i++)
 	{
 		uint8_t entry = table->blockEntries[i];
 		uint8_t flag = _get_block_entry_flag(entry);
 
-		total_memory_allocated_in_blocks--;
-
 		if (flag == _FBLOCK_FREE)
 		{
 			break; // Already free, stop
 		}
 
 		table->blockEntries[i] = _FBLOCK_FREE;
+		freed++;
+
 		if (!(entry & _FBLOCK_HAS_NEXT))
 		{
 			break;
 		}
 	}
+
+	return freed;
+}
+
+// Gives a run of blocks back to the index, merging it with free neighbours
+static void _release_blocks(struct Heap *heap, uint32_t start, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	uint32_t end = start + count;
+
+	if (start > 0 && _is_block_free(heap, start - 1))
+	{
+		uint32_t leftSize = heap->extents[start - 1].size;
+		start -= leftSize;
+		count += leftSize;
+		_extent_remove(heap, start);
+	}
+
+	if (end < heap->table->total && _is_block_free(heap, end))
+	{
+		count += heap->extents[end].size;
+		_extent_remove(heap, end);
+	}
+
+	_extent_insert(heap, start, count);
 }
 
 static void _set_blocks_taken(struct Heap *heap, int startBlock, int totalBlocks)
@@ -129,8 +256,6 @@ static void _set_blocks_taken(struct Heap *heap, int startBlock, int totalBlocks
 		{
 			entry |= _FBLOCK_HAS_NEXT;
 		}
-
-		total_memory_allocated_in_blocks++;
 	}
 }
 
@@ -144,6 +269,29 @@ static inline int _address_to_block(struct Heap *heap, void *address)
 	return (uintptr_t)((uintptr_t)address - (uintptr_t)heap->startAddress) / HEAP_BLOCK_SIZE;
 }
 
+// First block of the allocation starting at ptr, HEAP_NIL for anything else
+static uint32_t _allocation_block(struct Heap *heap, void *ptr)
+{
+	if (ptr < heap->startAddress || !_is_aligned(ptr))
+	{
+		return HEAP_NIL;
+	}
+
+	uint32_t block = _address_to_block(heap, ptr);
+	if (block >= heap->table->total)
+	{
+		return HEAP_NIL;
+	}
+
+	uint8_t entry = heap->table->blockEntries[block];
+	if (!(entry & _FBLOCK_USED) || !(entry & _FBLOCK_IS_FIRST))
+	{
+		return HEAP_NIL;
+	}
+
+	return block;
+}
+
 // Finds free blocks and marks them as allocated, returning a pointer to the memory
 static void *_malloc_blocks(struct Heap *heap, uint32_t totalBlocks)
 {
@@ -181,6 +329,23 @@ int create_heap(struct Heap *heap, struct HeapTable *table, void *startPtr, void
 	size_t tableSize = sizeof(uint8_t) * table->total;
 	memset(table->blockEntries, _FBLOCK_FREE, tableSize);
 
+	// The extent tags live in the first blocks of the heap itself
+	uint32_t indexBlocks = _align_value_to_block_size(sizeof(struct HeapExtent) * table->total) / HEAP_BLOCK_SIZE;
+	if (indexBlocks >= table->total)
+	{
+		return NO_MEMORY;
+	}
+
+	heap->extents = (struct HeapExtent *)startPtr;
+
+	for (int i = 0; i < HEAP_BUCKETS; i++)
+	{
+		heap->buckets[i] = HEAP_NIL;
+	}
+
+	_set_blocks_taken(heap, 0, indexBlocks);
+	_extent_insert(heap, indexBlocks, table->total - indexBlocks);
+
 	return SUCCESS;
 }
 
@@ -221,8 +386,8 @@ void *hrealloc(struct Heap *heap, void *ptr, size_t newSize)
 
 	size_t aligned_size = _align_value_to_block_size(newSize);
 	int total_blocks = aligned_size / HEAP_BLOCK_SIZE;
-	int start_block = _address_to_block(heap, ptr);
-	if (start_block < 0)
+	uint32_t start_block = _allocation_block(heap, ptr);
+	if (start_block == HEAP_NIL || (heap->table->blockEntries[start_block] & _FBLOCK_MOVABLE))
 		return 0x0;
 
 	// Count current allocated blocks
@@ -236,23 +401,27 @@ void *hrealloc(struct Heap *heap, void *ptr, size_t newSize)
 	if (current_blocks >= total_blocks)
 		return ptr; // Enough space
 
-	// Check if we can extend in place
-	int extendable = 1;
-	for (int i = start_block + current_blocks; i < start_block + total_blocks && i < heap->table->total; i++) {
-		if (_get_block_entry_flag(heap->table->blockEntries[i]) != _FBLOCK_FREE) {
-			extendable = 0;
-			break;
-		}
-	}
+	// Check if we can extend in place, the free run right after
+	// the allocation always starts at its next block
+	uint32_t next_block = start_block + current_blocks;
+	uint32_t missing = total_blocks - current_blocks;
+
+	if (next_block < heap->table->total && _is_block_free(heap, next_block) &&
+		heap->extents[next_block].size >= missing) {
+		uint32_t size = heap->extents[next_block].size;
+		_extent_remove(heap, next_block);
+
+		if (size > missing)
+			_extent_insert(heap, next_block + missing, size - missing);
+
+		heap->table->blockEntries[next_block - 1] |= _FBLOCK_HAS_NEXT;
 
-	if (extendable) {
 		// Mark additional blocks as used
-		for (int i = start_block + current_blocks; i < start_block + total_blocks; i++) {
+		for (int i = next_block; i < start_block + total_blocks; i++) {
 			uint8_t entry = _FBLOCK_USED;
 			if (i != start_block + total_blocks - 1)
 				entry |= _FBLOCK_HAS_NEXT;
 			heap->table->blockEntries[i] = entry;
-			total_memory_allocated_in_blocks++;
 		}
 
 		return ptr;
@@ -265,12 +434,165 @@ void *hrealloc(struct Heap *heap, void *ptr, size_t newSize)
 
 	size_t copy_size = current_blocks * HEAP_BLOCK_SIZE;
 	memcpy(new_ptr, ptr, copy_size);
-	_set_blocks_free(heap, start_block);
+	hfree(heap, ptr);
 
 	return new_ptr;
 }
 
 void hfree(struct Heap *heap, void *ptr)
 {
-	_set_blocks_free(heap, _address_to_block(heap, ptr));
+	// Only the first block of an allocation can be released,
+	// movable ones go through hfree_movable() so the handle is not left dangling
+	uint32_t start_block = _allocation_block(heap, ptr);
+	if (start_block == HEAP_NIL || (heap->table->blockEntries[start_block] & _FBLOCK_MOVABLE))
+	{
+		return;
+	}
+
+	_release_blocks(heap, start_block, _set_blocks_free(heap, start_block));
+	heap->compactPending = 1;
+}
+
+// Used blocks are whatever the extent index does not hold, so the
+// counts can not drift from the table
+void heap_stats(struct Heap *heap, struct HeapStats *stats)
+{
+	memset(stats, 0, sizeof(struct HeapStats));
+
+	stats->totalBlocks = heap->table->total;
+	stats->freeBlocks = heap->freeBlocks;
+	stats->usedBlocks = stats->totalBlocks - stats->freeBlocks;
+
+	for (int bucket = 0; bucket < HEAP_BUCKETS; bucket++)
+	{
+		for (uint32_t i = heap->buckets[bucket]; i != HEAP_NIL; i = heap->extents[i].next)
+		{
+			stats->freeExtents++;
+
+			if (heap->extents[i].size > stats->largestFree)
+			{
+				stats->largestFree = heap->extents[i].size;
+			}
+		}
+	}
+
+	// 0 when all free memory is one extent, close to 100 when it is scattered
+	if (stats->freeBlocks)
+	{
+		stats->fragmentation = 100 - (stats->largestFree * 100) / stats->freeBlocks;
+	}
+}
+
+/*
+ * Movable allocations and compaction.
+ *
+ * A movable allocation is only reached through its HeapHandle. hcompact()
+ * walks the table from the bottom and slides every unpinned movable
+ * allocation that sits right above a free extent down into it, so the free
+ * space bubbles up and merges into bigger extents. Pinned and ordinary
+ * allocations stay where they are.
+ */
+
+int hmalloc_movable(struct Heap *heap, struct HeapHandle *handle, size_t size)
+{
+	uint32_t total_blocks = _align_value_to_block_size(size) / HEAP_BLOCK_SIZE;
+
+	void *ptr = _malloc_blocks(heap, total_blocks);
+	if (!ptr)
+	{
+		return NO_MEMORY;
+	}
+
+	int block = _address_to_block(heap, ptr);
+	heap->table->blockEntries[block] |= _FBLOCK_MOVABLE;
+	heap->extents[block].handle = handle;
+
+	handle->ptr = ptr;
+	handle->blocks = total_blocks;
+	handle->pins = 0;
+
+	return SUCCESS;
+}
+
+void hfree_movable(struct Heap *heap, struct HeapHandle *handle)
+{
+	if (!handle->ptr)
+	{
+		return;
+	}
+
+	int block = _address_to_block(heap, handle->ptr);
+	if (!(heap->table->blockEntries[block] & _FBLOCK_MOVABLE) || heap->extents[block].handle != handle)
+	{
+		return;
+	}
+
+	_release_blocks(heap, block, _set_blocks_free(heap, block));
+	heap->compactPending = 1;
+
+	handle->ptr = 0x0;
+}
+
+// Stops once maxBlocks were moved, a full pass clears compactPending.
+// Returns the number of blocks moved
+uint32_t hcompact(struct Heap *heap, uint32_t maxBlocks)
+{
+	uint8_t *entries = heap->table->blockEntries;
+	uint32_t moved = 0;
+	uint32_t i = 0;
+
+	while (i < heap->table->total)
+	{
+		if (!_is_block_free(heap, i))
+		{
+			i++;
+			continue;
+		}
+
+		// Free extents are always merged, the block after one is an allocation head
+		uint32_t hole = heap->extents[i].size;
+		uint32_t next = i + hole;
+		if (next >= heap->table->total)
+		{
+			break;
+		}
+
+		struct HeapHandle *handle = heap->extents[next].handle;
+		if (!(entries[next] & _FBLOCK_MOVABLE) || handle->pins)
+		{
+			i = next;
+			continue;
+		}
+
+		uint32_t blocks = handle->blocks;
+		if (moved && moved + blocks > maxBlocks)
+		{
+			return moved;
+		}
+
+		_extent_remove(heap, i);
+		memmove(_block_to_address(heap, i), handle->ptr, blocks * HEAP_BLOCK_SIZE);
+
+		for (uint32_t k = 0; k < blocks; k++)
+		{
+			entries[i + k] = entries[next + k];
+		}
+
+		for (uint32_t k = i + blocks; k < next + blocks; k++)
+		{
+			entries[k] = _FBLOCK_FREE;
+		}
+
+		heap->extents[i].handle = handle;
+		handle->ptr = _block_to_address(heap, i);
+
+		_release_blocks(heap, i + blocks, hole);
+
+		moved += blocks;
+		i += blocks;
+	}
+
+	heap->compactPending = 0;
+
+	return moved;
 }
@@ -1,13 +1,21 @@
 #include <memory/kheap.h>
 #include <memory/heap.h>
+#include <memory/slab.h>
+#include <memory/memstat.h>
 
 #include <drivers/terminal.h>
 #include <core/kernel.h>
+#include <arch/i386/cpu.h>
 #include <def/config.h>
+#include <def/status.h>
 #include <lib/mem.h>
 
 /*
  * Kernel heap manager
+ *
+ * Requests up to SLAB_MAX_SIZE are served by the slab size classes,
+ * anything bigger goes straight to the block heap. A block allocation that
+ * fails compacts the heap once and retries.
  */
 
 #include <stdint.h>
@@ -15,30 +23,175 @@
 static struct Heap kernelHeap;
 static struct HeapTable kernelHeapTable;
 
-extern uint32_t total_memory_allocated_in_blocks;
+static size_t _heapSize = 0;
+
+static struct kmem_cache _handleCache = KMEM_CACHE_INIT("heap_handle", sizeof(struct HeapHandle));
+static struct CompactStats _compactStats;
+
+// Sized by the boot stage from the E820 map, still reachable through the boot directory
+extern size_t bootHeapSize;
 
 int init_kheap(){
-	total_memory_allocated_in_blocks = 0;
+	_heapSize = bootHeapSize;
 	
 	kernelHeapTable.blockEntries = (uint8_t*) HEAP_TABLE_VIRT_BASE;
-	kernelHeapTable.total = HEAP_SIZE_BYTES / HEAP_BLOCK_SIZE;
+	kernelHeapTable.total = _heapSize / HEAP_BLOCK_SIZE;
+
+	return create_heap(&kernelHeap, &kernelHeapTable, (void*)HEAP_VIRT_BASE, (void*)(HEAP_VIRT_BASE + _heapSize));
+}
+
+size_t kheap_size(){
+	return _heapSize;
+}
+
+void kheap_stats(struct HeapStats* stats){
+	heap_stats(&kernelHeap, stats);
+}
+
+// The idle task calls in with interrupts on
+uint32_t kheap_compact(uint32_t maxBlocks){
+	if(!kernelHeap.compactPending){
+		return 0;
+	}
+
+	uint32_t flags = cpu_irq_save();
+
+	struct HeapStats stats;
+	heap_stats(&kernelHeap, &stats);
+	uint32_t before = stats.fragmentation;
 
-	return create_heap(&kernelHeap, &kernelHeapTable, (void*)HEAP_VIRT_BASE, (void*)HEAP_VIRT_END);
+	uint32_t moved = hcompact(&kernelHeap, maxBlocks);
+	if(moved){
+		heap_stats(&kernelHeap, &stats);
+
+		_compactStats.runs++;
+		_compactStats.blocksMoved += moved;
+		_compactStats.fragmentationBefore = before;
+		_compactStats.fragmentationAfter = stats.fragmentation;
+	}
+
+	cpu_irq_restore(flags);
+
+	return moved;
 }
 
-void* kmalloc(size_t size){
-	return hmalloc(&kernelHeap, size);
+void kheap_compact_stats(struct CompactStats* stats){
+	*stats = _compactStats;
+}
+
+static void* _block_alloc(size_t size){
+	void* ptr = hmalloc(&kernelHeap, size);
+	if(!ptr && kheap_compact(KHEAP_COMPACT_ALL)){
+		ptr = hmalloc(&kernelHeap, size);
+	}
+
+	return ptr;
+}
+
+void* (kmalloc)(size_t size){
+	memstat_record(size);
+
+	if(size <= SLAB_MAX_SIZE){
+		return kmem_alloc_size(size);
+	}
+
+	return _block_alloc(size);
+}
+
+void* kmalloc_site(size_t size, const char* file, int line){
+	if(file){
+		memstat_record_site(file, line, size);
+	}
+
+	return (kmalloc)(size);
 }
 
 void* kcalloc(size_t nmemb, size_t size){
-	return hcalloc(&kernelHeap, nmemb, size);
+	// check if multiplication would overflow
+	if (nmemb != 0 && size > SIZE_MAX / nmemb){
+		return 0x0;
+	}
+
+	size_t total = nmemb * size;
+	memstat_record(total);
+
+	void* ptr = total > SLAB_MAX_SIZE ? _block_alloc(total) : kmem_alloc_size(total);
+	if(ptr){
+		memset(ptr, 0x0, total);
+	}
+
+	return ptr;
 }
 
 void* krealloc(void *ptr, size_t newSize){
-	return hrealloc(&kernelHeap, ptr, newSize);
+	if(!ptr || !kmem_is_slab_object(ptr)){
+		return hrealloc(&kernelHeap, ptr, newSize);
+	}
+
+	if(newSize == 0){
+		kmem_free(ptr);
+		return 0x0;
+	}
+
+	size_t oldSize = kmem_object_size(ptr);
+	if(newSize <= oldSize){
+		return ptr;
+	}
+
+	void* newPtr = (kmalloc)(newSize);
+	if(!newPtr){
+		return 0x0;
+	}
+
+	memcpy(newPtr, ptr, oldSize);
+	kmem_free(ptr);
+
+	return newPtr;
 }
 
 void kfree(void *ptr){
+	if(!ptr || (uintptr_t)ptr < HEAP_VIRT_BASE || (uintptr_t)ptr >= HEAP_VIRT_BASE + _heapSize){
+		return;
+	}
+
+	if(kmem_is_slab_object(ptr)){
+		kmem_free(ptr);
+		return;
+	}
+
 	hfree(&kernelHeap, ptr);
 }
 
+struct HeapHandle* kmalloc_movable(size_t size){
+	struct HeapHandle* handle = kmem_cache_alloc(&_handleCache);
+	if(!handle){
+		return 0x0;
+	}
+
+	memstat_record(size);
+
+	int res = hmalloc_movable(&kernelHeap, handle, size);
+	if(res != SUCCESS && kheap_compact(KHEAP_COMPACT_ALL)){
+		res = hmalloc_movable(&kernelHeap, handle, size);
+	}
+
+	if(res != SUCCESS){
+		kmem_cache_free(&_handleCache, handle);
+		return 0x0;
+	}
+
+	return handle;
+}
+
+void kfree_movable(struct HeapHandle* handle){
+	if(!handle){
+		return;
+	}
+
+	if(handle->pins){
+		warning("kfree_movable(): handle 0x%x is still pinned\n", handle);
+	}
+
+	hfree_movable(&kernelHeap, handle);
+	kmem_cache_free(&_handleCache, handle);
+}
@@ -0,0 +1,252 @@
+#include <memory/slab.h>
+#include <memory/kheap.h>
+#include <core/kernel.h>
+#include <def/config.h>
+#include <lib/mem.h>
+#include <stdint.h>
+
+/*
+ * Slab object cache.
+ *
+ * Each slab is a single heap block with a small header at its start, followed by
+ * fixed-size objects. Free objects are chained through their first word, so
+ * allocation and free are O(1) and small objects no longer burn a whole block.
+ */
+
+#define _SLAB_MAGIC 0x51AB51AB
+
+// Empty slabs kept per cache before returning blocks to the heap
+#define _SLAB_EMPTY_MAX 1
+
+struct slab {
+	uint32_t magic;
+	struct kmem_cache* cache;
+
+	void* freeList;
+	uint16_t inUse;
+
+	struct slab* next;
+	struct slab* prev;
+};
+
+static struct kmem_cache _sizeCaches[SLAB_SIZE_CLASSES] = {
+	KMEM_CACHE_INIT("size-16", 16),
+	KMEM_CACHE_INIT("size-32", 32),
+	KMEM_CACHE_INIT("size-64", 64),
+	KMEM_CACHE_INIT("size-128", 128),
+	KMEM_CACHE_INIT("size-256", 256),
+	KMEM_CACHE_INIT("size-512", 512),
+	KMEM_CACHE_INIT("size-1024", 1024),
+	KMEM_CACHE_INIT("size-2048", 2048),
+};
+
+static inline uint32_t _align_up(uint32_t val, uint32_t align){
+	return (val + align - 1) & ~(align - 1);
+}
+
+static inline uint32_t _slab_header_size(){
+	return _align_up(sizeof(struct slab), SLAB_ALIGN);
+}
+
+static inline struct slab* _obj_to_slab(void* obj){
+	return (struct slab*)((uintptr_t)obj & ~(HEAP_BLOCK_SIZE - 1));
+}
+
+static inline int _size_to_class(size_t size){
+	if(size <= SLAB_MIN_SIZE){
+		return 0;
+	}
+
+	// ceil(log2(size)) - log2(SLAB_MIN_SIZE)
+	return (32 - __builtin_clz((uint32_t)size - 1)) - 4;
+}
+
+static void _list_add(struct slab** head, struct slab* slab){
+	slab->prev = 0x0;
+	slab->next = *head;
+
+	if(*head){
+		(*head)->prev = slab;
+	}
+
+	*head = slab;
+}
+
+static void _list_remove(struct slab** head, struct slab* slab){
+	if(slab->prev){
+		slab->prev->next = slab->next;
+	}else{
+		*head = slab->next;
+	}
+
+	if(slab->next){
+		slab->next->prev = slab->prev;
+	}
+
+	slab->next = 0x0;
+	slab->prev = 0x0;
+}
+
+static void _cache_setup(struct kmem_cache* cache){
+	uint32_t size = cache->objectSize;
+	if(size < sizeof(void*)){
+		size = sizeof(void*);
+	}
+
+	cache->objectSize = _align_up(size, SLAB_ALIGN);
+	cache->objectsPerSlab = (HEAP_BLOCK_SIZE - _slab_header_size()) / cache->objectSize;
+}
+
+static struct slab* _cache_grow(struct kmem_cache* cache){
+	if(!cache->objectsPerSlab){
+		_cache_setup(cache);
+
+		if(!cache->objectsPerSlab){
+			return 0x0; // Object does not fit in a slab
+		}
+	}
+
+	// Blocks bigger than the slab limit always come from the block heap
+	struct slab* slab = (struct slab*)kmalloc(HEAP_BLOCK_SIZE);
+	if(!slab){
+		return 0x0;
+	}
+
+	slab->magic = _SLAB_MAGIC;
+	slab->cache = cache;
+	slab->inUse = 0;
+	slab->freeList = 0x0;
+
+	uint8_t* base = (uint8_t*)slab + _slab_header_size();
+	for(int i = cache->objectsPerSlab - 1; i >= 0; i--){
+		void** obj = (void**)(base + (i * cache->objectSize));
+		*obj = slab->freeList;
+		slab->freeList = obj;
+	}
+
+	cache->totalSlabs++;
+	_list_add(&cache->partial, slab);
+
+	return slab;
+}
+
+void* kmem_cache_alloc(struct kmem_cache* cache){
+	if(!cache){
+		return 0x0;
+	}
+
+	struct slab* slab = cache->partial;
+	if(!slab && (slab = cache->empty)){
+		_list_remove(&cache->empty, slab);
+		_list_add(&cache->partial, slab);
+	}
+
+	if(!slab && !(slab = _cache_grow(cache))){
+		return 0x0;
+	}
+
+	void** obj = (void**)slab->freeList;
+	slab->freeList = *obj;
+	slab->inUse++;
+	cache->activeObjects++;
+
+	if(!slab->freeList){
+		_list_remove(&cache->partial, slab);
+		_list_add(&cache->full, slab);
+	}
+
+	return (void*)obj;
+}
+
+void* kmem_cache_zalloc(struct kmem_cache* cache){
+	void* obj = kmem_cache_alloc(cache);
+	if(obj){
+		memset(obj, 0x0, cache->objectSize);
+	}
+
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache* cache, void* obj){
+	if(!obj){
+		return;
+	}
+
+	struct slab* slab = _obj_to_slab(obj);
+	if(slab->magic != _SLAB_MAGIC || (cache && slab->cache != cache)){
+		warning("kmem_cache_free(): bad object 0x%x\n", obj);
+		return;
+	}
+
+	cache = slab->cache;
+
+	if(!slab->freeList){
+		_list_remove(&cache->full, slab);
+		_list_add(&cache->partial, slab);
+	}
+
+	*(void**)obj = slab->freeList;
+	slab->freeList = obj;
+	slab->inUse--;
+	cache->activeObjects--;
+
+	if(slab->inUse == 0){
+		_list_remove(&cache->partial, slab);
+		_list_add(&cache->empty, slab);
+
+		kmem_cache_shrink(cache);
+	}
+}
+
+// Release all empty slabs except the ones kept as reserve
+void kmem_cache_shrink(struct kmem_cache* cache){
+	uint32_t kept = 0;
+
+	struct slab* slab = cache->empty;
+	while(slab){
+		struct slab* next = slab->next;
+
+		if(kept < _SLAB_EMPTY_MAX){
+			kept++;
+		}else{
+			_list_remove(&cache->empty, slab);
+			slab->magic = 0;
+			cache->totalSlabs--;
+			kfree(slab);
+		}
+
+		slab = next;
+	}
+}
+
+void* kmem_alloc_size(size_t size){
+	if(size == 0 || size > SLAB_MAX_SIZE){
+		return 0x0;
+	}
+
+	return kmem_cache_alloc(&_sizeCaches[_size_to_class(size)]);
+}
+
+void kmem_free(void* obj){
+	kmem_cache_free(0x0, obj);
+}
+
+size_t kmem_object_size(void* obj){
+	struct slab* slab = _obj_to_slab(obj);
+	if(slab->magic != _SLAB_MAGIC){
+		return 0;
+	}
+
+	return slab->cache->objectSize;
+}
+
+// Totals over the kmalloc size classes
+void kmem_size_stats(uint32_t* slabs, uint32_t* objects){
+	*slabs = 0;
+	*objects = 0;
+
+	for(int i = 0; i < SLAB_SIZE_CLASSES; i++){
+		*slabs += _sizeCaches[i].totalSlabs;
+		*objects += _sizeCaches[i].activeObjects;
+	}
+}
@@ -0,0 +1,189 @@
+#include <memory/memstat.h>
+#include <memory/page_alloc.h>
+#include <memory/kheap.h>
+#include <memory/heap.h>
+#include <memory/slab.h>
+#include <memory/swap.h>
+#include <core/process.h>
+#include <core/sched.h>
+#include <lib/serial.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <uaccess.h>
+#include <syscall.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * Memory statistics
+ *
+ * Heap and frame counters are read from the allocators when asked for,
+ * only the kmalloc size histogram and the call site table are kept up
+ * to date on the allocation path. Call sites are recorded when the
+ * kernel is built with MEMSTAT_CALLSITES, see memory/kheap.h.
+ *
+ * The report goes to userland through sys_memstat and to COM1 through
+ * memstat_dump(), bound to Ctrl+Alt+M by the keyboard driver.
+ */
+
+struct memstat_site {
+	const char* file;
+	uint32_t line;
+	uint32_t calls;
+	uint32_t bytes;
+};
+
+static uint32_t _histogram[MEMSTAT_HIST_BUCKETS];
+
+static struct memstat_site _sites[MEMSTAT_SITES_MAX];
+static uint32_t _sitesDropped = 0; // Allocations from sites that did not fit in the table
+
+extern struct Process* _processes[PROC_MAX];
+
+void memstat_record(size_t size){
+	uint32_t bucket = size <= 16 ? 0 : (32 - __builtin_clz((uint32_t)size - 1)) - 4;
+	if(bucket >= MEMSTAT_HIST_BUCKETS){
+		bucket = MEMSTAT_HIST_BUCKETS - 1;
+	}
+
+	_histogram[bucket]++;
+}
+
+// Open addressing on the (file, line) pair, __FILE__ strings are unique per file
+void memstat_record_site(const char* file, int line, size_t size){
+	uint32_t hash = ((uintptr_t)file >> 2) ^ ((uint32_t)line * 31);
+
+	for(uint32_t i = 0; i < MEMSTAT_SITES_MAX; i++){
+		struct memstat_site* site = &_sites[(hash + i) % MEMSTAT_SITES_MAX];
+
+		if(!site->file){
+			site->file = file;
+			site->line = line;
+		}
+
+		if(site->file == file && site->line == (uint32_t)line){
+			site->calls++;
+			site->bytes += size;
+			return;
+		}
+	}
+
+	_sitesDropped++;
+}
+
+void memstat_collect(struct memstat* stats, struct Process* process){
+	struct HeapStats heap;
+	kheap_stats(&heap);
+
+	memset(stats, 0x0, sizeof(struct memstat));
+
+	stats->heapBlockSize = HEAP_BLOCK_SIZE;
+	stats->heapTotalBlocks = heap.totalBlocks;
+	stats->heapUsedBlocks = heap.usedBlocks;
+	stats->heapFreeBlocks = heap.freeBlocks;
+	stats->heapFreeExtents = heap.freeExtents;
+	stats->heapLargestFree = heap.largestFree;
+	stats->heapFragmentation = heap.fragmentation;
+
+	struct CompactStats compact;
+	kheap_compact_stats(&compact);
+
+	stats->compactions = compact.runs;
+	stats->compactedBlocks = compact.blocksMoved;
+	stats->compactFragBefore = compact.fragmentationBefore;
+	stats->compactFragAfter = compact.fragmentationAfter;
+
+	kmem_size_stats(&stats->slabs, &stats->slabObjects);
+
+	stats->totalPages = page_alloc_total_count();
+	stats->freePages = page_alloc_free_count();
+
+	swap_stats(&stats->swapSlots, &stats->swapUsed);
+
+	if(process && process->mm && process->mm->pageDirectory){
+		mmu_directory_stats(process->mm->pageDirectory, &stats->pageTables, &stats->residentPages);
+	}
+
+	memcpy(stats->sizeHistogram, _histogram, sizeof(_histogram));
+}
+
+void memstat_dump(){
+	static uint8_t serialReady = 0;
+	if(!serialReady){
+		serial_init();
+		serialReady = 1;
+	}
+
+	struct memstat stats;
+	memstat_collect(&stats, 0x0);
+
+	serial_printf("--memstat--\n");
+	serial_printf("heap:   %d/%d blocks used, %d free in %d extents\n",
+		stats.heapUsedBlocks, stats.heapTotalBlocks, stats.heapFreeBlocks, stats.heapFreeExtents);
+	serial_printf("        largest free %d blocks, fragmentation index %d\n",
+		stats.heapLargestFree, stats.heapFragmentation);
+	serial_printf("        %d compactions moved %d blocks, last one %d -> %d\n",
+		stats.compactions, stats.compactedBlocks, stats.compactFragBefore, stats.compactFragAfter);
+	serial_printf("slab:   %d slabs, %d objects\n", stats.slabs, stats.slabObjects);
+	serial_printf("frames: %d/%d free\n", stats.freePages, stats.totalPages);
+	serial_printf("swap:   %d/%d slots used\n", stats.swapUsed, stats.swapSlots);
+
+	serial_printf("kmalloc sizes:\n");
+	for(int i = 0; i < MEMSTAT_HIST_BUCKETS; i++){
+		if(!stats.sizeHistogram[i]){
+			continue;
+		}
+
+		if(i == MEMSTAT_HIST_BUCKETS - 1){
+			serial_printf("  >  %d: %d\n", 16 << (i - 1), stats.sizeHistogram[i]);
+		}else{
+			serial_printf("  <= %d: %d\n", 16 << i, stats.sizeHistogram[i]);
+		}
+	}
+
+	serial_printf("call sites:\n");
+	for(int i = 0; i < MEMSTAT_SITES_MAX; i++){
+		if(_sites[i].file){
+			serial_printf("  %s:%d %d bytes in %d calls\n", _sites[i].file, _sites[i].line, _sites[i].bytes, _sites[i].calls);
+		}
+	}
+
+	if(_sitesDropped){
+		serial_printf("  %d allocations from untracked sites\n", _sitesDropped);
+	}
+
+	serial_printf("processes:\n");
+	for(int i = 0; i < PROC_MAX; i++){
+		struct Process* process = _processes[i];
+		if(!process || !process->mm || !process->mm->pageDirectory){
+			continue;
+		}
+
+		uint32_t tables, resident;
+		mmu_directory_stats(process->mm->pageDirectory, &tables, &resident);
+		serial_printf("  %d %s: %d page tables, %d resident pages\n", process->pid, process->name, tables, resident);
+	}
+
+	serial_printf("-----------\n");
+}
+
+SYSCALL_DEFINE2(memstat, struct memstat*, buffer, int, flags){
+	struct Task* task = pcb_current();
+	if(!task || !task->process){
+		return INVALID_STATE;
+	}
+
+	struct memstat stats;
+	memstat_collect(&stats, task->process);
+
+	int res = copy_to_user(&stats, buffer, sizeof(stats));
+	if(res != SUCCESS){
+		return res;
+	}
+
+	if(flags & MEMSTAT_DUMP){
+		memstat_dump();
+	}
+
+	return SUCCESS;
+}
@@ -0,0 +1,156 @@
+#include <mmu.h>
+#include <core/sched.h>
+#include <core/process.h>
+#include <syscall.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <stdint.h>
+
+/*
+ * Userland memory syscalls, anonymous private mappings and the brk heap.
+ * Regions are only recorded here, frames come from the page-fault handler.
+ */
+
+static inline uint8_t _prot_to_flags(int prot){
+	uint8_t flags = FPAGING_P;
+
+	if(prot & (PROT_READ | PROT_WRITE | PROT_EXEC)){
+		flags |= FPAGING_US;
+	}
+
+	if(prot & PROT_WRITE){
+		flags |= FPAGING_RW;
+	}
+
+	return flags;
+}
+
+static inline struct mm_struct* _current_mm(){
+	struct Task* task = pcb_current();
+	if(!task || !task->process){
+		return 0x0;
+	}
+
+	return task->process->mm;
+}
+
+static inline uint8_t _user_range(uintptr_t addr, uint32_t size){
+	return addr + size >= addr && addr + size <= KERNEL_VIRT_BASE;
+}
+
+SYSCALL_DEFINE4(mmap, void*, addr, uint32_t, length, int, prot, int, flags){
+	struct mm_struct* mm = _current_mm();
+	if(!mm){
+		return INVALID_STATE;
+	}
+
+	if(length == 0 || (uintptr_t)addr & (PAGING_PAGE_SIZE - 1)){
+		return INVALID_ARG;
+	}
+
+	// No file mappings and no sharing between processes yet
+	if(!(flags & MAP_ANONYMOUS) || !(flags & MAP_PRIVATE)){
+		return NOT_SUPPORTED;
+	}
+
+	uint32_t size = (uint32_t)paging_align_address((void*)length);
+	if(size < length){
+		return INVALID_ARG;
+	}
+
+	uintptr_t start = (uintptr_t)addr;
+
+	if(flags & MAP_FIXED){
+		if(!start || !_user_range(start, size)){
+			return INVALID_ARG;
+		}
+
+		int res = vma_remove(mm, addr, size);
+		if(res != SUCCESS){
+			return res;
+		}
+	}else if(!start || !_user_range(start, size) || !vma_range_free(mm, addr, size)){
+		// The address is only a hint
+		start = (uintptr_t)vma_find_free(mm, mm->mmapBase, size);
+		if(!start){
+			return NO_MEMORY;
+		}
+	}
+
+	uint8_t pageFlags = _prot_to_flags(prot);
+
+	int res = vma_add(mm, (void*)start, 0x0, size, pageFlags, 1);
+	if(res != SUCCESS){
+		return res;
+	}
+
+	if((flags & MAP_POPULATE) && (pageFlags & FPAGING_US)){
+		res = vma_populate(mm, (void*)start, size);
+		if(res != SUCCESS){
+			vma_remove(mm, (void*)start, size);
+			return res;
+		}
+	}
+
+	return (long)start;
+}
+
+SYSCALL_DEFINE2(munmap, void*, addr, uint32_t, length){
+	struct mm_struct* mm = _current_mm();
+	if(!mm){
+		return INVALID_STATE;
+	}
+
+	if(length == 0 || (uintptr_t)addr & (PAGING_PAGE_SIZE - 1) || !_user_range((uintptr_t)addr, length)){
+		return INVALID_ARG;
+	}
+
+	return vma_remove(mm, addr, length);
+}
+
+SYSCALL_DEFINE3(mprotect, void*, addr, uint32_t, length, int, prot){
+	struct mm_struct* mm = _current_mm();
+	if(!mm){
+		return INVALID_STATE;
+	}
+
+	if(length == 0 || (uintptr_t)addr & (PAGING_PAGE_SIZE - 1) || !_user_range((uintptr_t)addr, length)){
+		return INVALID_ARG;
+	}
+
+	return vma_protect(mm, addr, length, _prot_to_flags(prot));
+}
+
+// Set the end of the heap, returns the break in effect afterwards
+SYSCALL_DEFINE1(brk, void*, addr){
+	struct mm_struct* mm = _current_mm();
+	if(!mm){
+		return INVALID_STATE;
+	}
+
+	uintptr_t brk = (uintptr_t)addr;
+
+	// Queries and requests outside the heap area just report the break
+	if(!mm->brkStart || brk < mm->brkStart || brk > PROC_MMAP_VIRTUAL_BASE){
+		return (long)mm->brk;
+	}
+
+	uintptr_t oldEnd = (uintptr_t)paging_align_address((void*)mm->brk);
+	uintptr_t newEnd = (uintptr_t)paging_align_address((void*)brk);
+
+	// The new pages merge into the heap region
+	int res = SUCCESS;
+	if(newEnd > oldEnd){
+		res = vma_range_free(mm, (void*)oldEnd, newEnd - oldEnd)
+			? vma_add(mm, (void*)oldEnd, 0x0, newEnd - oldEnd, FPAGING_P | FPAGING_RW | FPAGING_US, 1)
+			: ALREADY_MAPD;
+	}else if(newEnd < oldEnd){
+		res = vma_remove(mm, (void*)newEnd, oldEnd - newEnd);
+	}
+
+	if(res == SUCCESS){
+		mm->brk = brk;
+	}
+
+	return (long)mm->brk;
+}
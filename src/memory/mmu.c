@@ -1,12 +1,16 @@
 #include "def/status.h"
 #include <mmu.h>
 #include <memory/paging.h>
+#include <memory/page_alloc.h>
+#include <memory/pgtable.h>
+#include <memory/swap.h>
 #include <def/config.h>
 #include <def/err.h>
 #include <core/kernel.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <arch/i386/idt.h>
+#include <arch/i386/cpu.h>
 #include <drivers/terminal.h>
 #include <core/sched.h>
 
@@ -15,8 +19,17 @@
 	((uintptr_t)(phys) & (PAGING_PAGE_SIZE - 1)))
 
 static struct PagingDirectory* _kernelDirectory = 0x0;
+static uint8_t _largePages = 0; // CR4.PSE is on
+static uint32_t _globalFlag = 0; // FPAGING_G once CR4.PGE is on, kernel half entries only
 struct PagingDirectory* _currentDirectory = 0x0;
 
+// Kernel half page tables, allocated once in mmu_init and shared by every directory
+static PagingTable* _kernelTables[PAGING_KERNEL_TABLES];
+
+// Backs kmap(), one of the kernel tables
+static PagingTable* _kmapTable = 0x0;
+static uint32_t _kmapUsed = 0;
+
 static inline int _read_cr2(){
 	uint32_t cr2;
 	__asm__ volatile("mov %%cr2, %0" : "=r" (cr2));
@@ -52,41 +65,43 @@ static inline void _show_pf_info(pf_info_t pf){
 }
 
 static void _page_fault_handler(struct InterruptFrame* frame){
-	void* faultingAddress = (void*)frame->eip;
+	void* faultingAddress = (void*)_read_cr2();
 	pf_info_t pf = pf_decode(frame->err_code, faultingAddress);
 
 	struct mm_struct* mm = 0x0;
 	struct Task* task = pcb_current();
 
-	_show_pf_info(pf);
-
 	if(task && task->process){
 		mm = task->process->mm;
-	}else{
-		panic("Page fault in kernel mode!");
 	}
 
-	struct mem_region* v = vma_lookup(mm, faultingAddress);
+	// Demand paging and copy-on-write, back the page if the access fits the region
+	if(mm && (!pf.present || pf.write) && (uintptr_t)faultingAddress < KERNEL_VIRT_BASE){
+		struct mem_region* v = vma_lookup(mm, faultingAddress);
 
-	if(!v){
-		panic(
-			"Invalid memory access in task %d (%s)\n",
-			task->tid, task->process ? task->process->name : "unknown"
-		);
-	}
+		if(v && (!pf.write || (v->flags & FPAGING_RW)) && (!pf.user || (v->flags & FPAGING_US))){
+			int res = vma_fault(mm, v, faultingAddress);
+			if(res == SUCCESS){
+				return;
+			}
 
-	if(!pf.present){
-		panic(
-			"Protection fault in task %d (%s)\n", 
-			task->tid, task->process ? task->process->name : "unknown"
-		);
+			warning("Page fault: could not back 0x%x (%d)\n", faultingAddress, res);
+		}
 	}
 
-	// kill process
-	
-	while(1){
-		__asm__ volatile ("hlt");
+	_show_pf_info(pf);
+
+	if(!pf.user || !mm){
+		panic("Page fault in kernel mode!");
 	}
+
+	terminal_write(
+		"Segmentation fault in task %d (%s)\n",
+		task->tid, task->process->name
+	);
+
+	// Only the offending process goes away
+	scheduler_exit_current();
 }
 
 static int _map_kernel(struct PagingDirectory* directory, void* virtualAddr, void* physicalAddr, uint8_t flags){
@@ -100,43 +115,98 @@ static int _map_kernel(struct PagingDirectory* directory, void* virtualAddr, voi
 	dirIndex = virt >> 22;
 	tblIndex = (virt >> 12) & 0x3FF;
 
-	PagingTable* table = 0x0;
-	if(!(directory->entry[dirIndex] & FPAGING_P)){
+	if(directory->entry[dirIndex] & FPAGING_PS){
+		return ALREADY_MAPD;
+	}
+
+	if(dirIndex < PAGING_USER_TABLES || dirIndex == SELF_PDE_INDEX){
+		return OUT_OF_BOUNDS;
+	}
+
+	PagingTable* table = _kernelTables[dirIndex - PAGING_USER_TABLES];
+	if(!table){
 		table = (PagingTable*)kcalloc(sizeof(PagingTable), PAGING_TOTAL_ENTRIES_PER_TABLE);
 		if (!table){
 			return NO_MEMORY;
 		}
 
+		_kernelTables[dirIndex - PAGING_USER_TABLES] = table;
+
 		directory->tableCount++;
 		directory->entry[dirIndex] = (PagingTable)mmu_translate(table) | flags;
-	}else{
-		uintptr_t tableVirt = (uintptr_t)phys_to_virt((void*)directory->entry[dirIndex]);
-		table = (PagingTable*)(tableVirt & PAGE_MASK);
 	}
 
 	if (table[tblIndex] & FPAGING_P) {
 		return ALREADY_MAPD;
 	}
 
-	table[tblIndex] = (uint32_t) physicalAddr | flags;
+	table[tblIndex] = (uint32_t) physicalAddr | flags | _globalFlag;
 
 	return SUCCESS;
 }
 
+// Back every kernel directory entry that is still empty with a table, so the
+// kernel half never changes again and copying it once per directory is enough
+static int _alloc_kernel_tables(struct PagingDirectory* directory){
+	for(uint32_t i = PAGING_USER_TABLES; i < SELF_PDE_INDEX; i++){
+		if(directory->entry[i] & FPAGING_P){
+			continue;
+		}
+
+		PagingTable* table = (PagingTable*)kcalloc(sizeof(PagingTable), PAGING_TOTAL_ENTRIES_PER_TABLE);
+		if(!table){
+			return NO_MEMORY;
+		}
+
+		_kernelTables[i - PAGING_USER_TABLES] = table;
+
+		directory->entry[i] = (PagingTable)mmu_translate(table) | FPAGING_P | FPAGING_RW;
+		directory->tableCount++;
+	}
+
+	return SUCCESS;
+}
+
+static int _map_kernel_large(struct PagingDirectory* directory, void* virtualAddr, void* physicalAddr, uint8_t flags){
+	uint32_t dirIndex = (uintptr_t)virtualAddr >> 22;
+
+	if(directory->entry[dirIndex] & FPAGING_P){
+		return ALREADY_MAPD;
+	}
+
+	directory->entry[dirIndex] = ((uintptr_t)physicalAddr & LARGE_PAGE_MASK) | flags | FPAGING_PS | _globalFlag;
+	directory->tableCount++;
+
+	return SUCCESS;
+}
+
+// 4 MiB pages wherever both addresses are aligned and a whole one fits, 4 KiB tables at the edges
 static int _map_kernel_range(struct PagingDirectory* directory, void* virtualAddr, void* physicalAddr, uint32_t size, uint8_t flags){
 	uint32_t alignedSize = (size + PAGING_PAGE_SIZE - 1) & ~(PAGING_PAGE_SIZE - 1);
-	uint32_t count = alignedSize / PAGING_PAGE_SIZE;
 
-	virtualAddr = paging_align_to_lower(virtualAddr);
-	physicalAddr = paging_align_to_lower(physicalAddr);
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(virtualAddr);
+	uintptr_t phys = (uintptr_t)paging_align_to_lower(physicalAddr);
+	uintptr_t end = virt + alignedSize;
+
+	while(virt < end){
+		uint32_t step = PAGING_PAGE_SIZE;
+		int status;
+
+		if(_largePages &&
+			!((virt | phys) & (PAGING_LARGE_PAGE_SIZE - 1)) &&
+			end - virt >= PAGING_LARGE_PAGE_SIZE)
+		{
+			step = PAGING_LARGE_PAGE_SIZE;
+			status = _map_kernel_large(directory, (void*)virt, (void*)phys, flags);
+		}else{
+			status = _map_kernel(directory, (void*)virt, (void*)phys, flags);
+		}
 
-	for(int i = 0; i < count; i++){
-		int status = _map_kernel(directory, virtualAddr, physicalAddr, flags);
 		if(status != SUCCESS)
 			return status;
 
-		virtualAddr = (void*)((uintptr_t)virtualAddr + PAGING_PAGE_SIZE);
-		physicalAddr = (void*)((uintptr_t)physicalAddr + PAGING_PAGE_SIZE);
+		virt += step;
+		phys += step;
 	}
 
 	return SUCCESS;
@@ -146,6 +216,18 @@ int mmu_init(){
 	_currentDirectory = 0x0;
 	_kernelDirectory = 0x0;
 
+	// Must be on before a directory with large entries is loaded
+	_largePages = cpu_has_feature_edx(CPUID_FEAT_EDX_PSE);
+	if(_largePages){
+		write_cr4(read_cr4() | CR4_PSE);
+	}
+
+	// Kernel half is identical in every directory, keep it cached across CR3 switches
+	if(cpu_has_feature_edx(CPUID_FEAT_EDX_PGE)){
+		write_cr4(read_cr4() | CR4_PGE);
+		_globalFlag = FPAGING_G;
+	}
+
 	struct PagingDirectory* dir = mmu_create_page();
 
 	extern uintptr_t __kernel_phys_start;
@@ -184,7 +266,7 @@ int mmu_init(){
 		dir,
 		(void*)HEAP_VIRT_BASE,
 		(void*)HEAP_PHYS_BASE,
-		HEAP_SIZE_BYTES,
+		kheap_size(),
 		flags
 	);
 
@@ -196,7 +278,19 @@ int mmu_init(){
 		dir, 
 		(void*)HEAP_TABLE_VIRT_BASE, 
 		(void*)HEAP_TABLE_PHYS_BASE, 
-		(HEAP_SIZE_BYTES / HEAP_BLOCK_SIZE), 
+		(kheap_size() / HEAP_BLOCK_SIZE), 
+		flags
+	);
+
+	if(IS_STAT_ERR(res)){
+		return res;
+	}
+
+	res = _map_kernel_range(
+		dir,
+		(void*)DMA_VIRT_BASE,
+		(void*)DMA_PHYS_BASE,
+		DMA_POOL_SIZE,
 		flags
 	);
 
@@ -219,10 +313,27 @@ int mmu_init(){
 		return res;
 	}
 	
+	res = _alloc_kernel_tables(dir);
+	if(IS_STAT_ERR(res)){
+		return res;
+	}
+
+	_kmapTable = _kernelTables[(KMAP_VIRT_BASE >> 22) - PAGING_USER_TABLES];
+
 	idt_register_callback(14, &_page_fault_handler);
 
 	_kernelDirectory = dir;
-	return mmu_page_switch(dir);
+
+	res = mmu_page_switch(dir);
+	if(IS_STAT_ERR(res)){
+		return res;
+	}
+
+	// kmap() works from here on, fill the pools for the first processes
+	zero_pool_refill(ZERO_POOL_HIGH);
+	pgtable_pool_refill(PGTABLE_POOL_SIZE);
+
+	return SUCCESS;
 }
 
 struct PagingDirectory* mmu_create_page(){
@@ -277,13 +388,16 @@ int mmu_destroy_page(struct PagingDirectory* directory){
 
 	if(directory == _kernelDirectory){
 		return INVALID_ARG;
-	}else{
+	}
+	
+	if(directory == _currentDirectory){
 		mmu_page_switch(_kernelDirectory);
 	}
 
-	for (uint16_t i = (KERNEL_VIRT_BASE >> 22); i < 1024; i++){
-		directory->entry[i] = 0;
-	}
+	// Kernel tables are shared, only the user half belongs to this directory
+	memset(&directory->entry[PAGING_USER_TABLES], 0x0, PAGING_KERNEL_TABLES * sizeof(uint32_t));
+
+	directory->entry[SELF_PDE_INDEX] = 0;
 
 	paging_free_directory(directory);
 
@@ -304,6 +418,273 @@ int mmu_unmap_pages(void* virtualStart, uint32_t size){
 	return paging_unmap_range(count, paging_align_to_lower(virtualStart));
 }
 
+// Back [virtualAddr, virtualAddr + size) in the current directory with zeroed frames
+int mmu_alloc_pages(void* virtualAddr, uint32_t size, uint8_t flags){
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(virtualAddr);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualAddr + size));
+
+	for(; virt < end; virt += PAGING_PAGE_SIZE){
+		PagingTable* pte = paging_pte((void*)virt);
+		if(pte && (*pte & (FPAGING_P | FPAGING_SWAP))){
+			continue; // Page shared with a previous region or swapped out
+		}
+
+		void* frame = alloc_zeroed_page();
+		if(!frame){
+			return NO_MEMORY;
+		}
+
+		int res = paging_map((void*)virt, frame, flags);
+		if(res != SUCCESS){
+			free_page(frame);
+			return res;
+		}
+	}
+
+	return SUCCESS;
+}
+
+// Unmap a range of any directory and give its frames back to the page allocator
+int mmu_release_pages(struct PagingDirectory* directory, void* virtualStart, uint32_t size){
+	if(!directory){
+		return NULL_PTR;
+	}
+
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(virtualStart);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualStart + size));
+
+	uint8_t current = (directory == _currentDirectory);
+	struct TlbBatch batch = { 0 };
+
+	while(virt < end){
+		uint32_t dirIndex = virt >> 22;
+
+		uintptr_t next = (virt & ~0x3FFFFF) + 0x400000;
+		if(!next || next > end){
+			next = end;
+		}
+
+		if(!(directory->entry[dirIndex] & FPAGING_P) || (directory->entry[dirIndex] & FPAGING_PS)){
+			virt = next;
+			continue;
+		}
+
+		PagingTable* table = (PagingTable*)kmap((void*)(directory->entry[dirIndex] & PAGE_MASK));
+		if(!table){
+			return OUT_OF_VMEM;
+		}
+
+		for(; virt < next; virt += PAGING_PAGE_SIZE){
+			uint32_t tblIndex = (virt >> 12) & 0x3FF;
+			if(paging_is_swap_entry(table[tblIndex])){
+				swap_free(paging_swap_slot(table[tblIndex]));
+				table[tblIndex] = 0;
+
+				if(dirIndex < PAGING_USER_TABLES){
+					directory->entryCount[dirIndex]--;
+				}
+
+				continue;
+			}
+
+			if(!(table[tblIndex] & FPAGING_P)){
+				continue;
+			}
+
+			free_page((void*)(table[tblIndex] & PAGE_MASK));
+			table[tblIndex] = 0;
+
+			if(dirIndex < PAGING_USER_TABLES){
+				directory->entryCount[dirIndex]--;
+			}
+
+			if(current){
+				paging_tlb_batch_add(&batch, (void*)virt);
+			}
+		}
+
+		kunmap(table);
+
+		if(dirIndex < PAGING_USER_TABLES && !directory->entryCount[dirIndex]){
+			pgtable_free((void*)(directory->entry[dirIndex] & PAGE_MASK));
+			directory->entry[dirIndex] = 0;
+			directory->tableCount--;
+
+			if(current){
+				paging_tlb_batch_add(&batch, VIRT_PTBL(dirIndex));
+			}
+		}
+	}
+
+	// Frames were freed before the flush, nothing runs on them in between on a single CPU
+	paging_tlb_batch_finish(&batch);
+
+	return SUCCESS;
+}
+
+/*
+ * Map the pages of src in [virtualStart, virtualStart + size) at the same
+ * addresses in dst. Private frames gain a reference and lose the write bit
+ * in both directories, the first write copies them (see vma_fault()).
+ * Swapped out private pages gain a reference on their slot instead.
+ * Pages already mapped in dst are kept.
+ */
+int mmu_share_pages(struct PagingDirectory* dst, struct PagingDirectory* src, void* virtualStart, uint32_t size, uint8_t isPrivate){
+	if(!dst || !src){
+		return NULL_PTR;
+	}
+
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(virtualStart);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualStart + size));
+
+	if(end < virt || end > KERNEL_VIRT_BASE){
+		return OUT_OF_BOUNDS;
+	}
+
+	uint8_t current = (src == _currentDirectory);
+	struct TlbBatch batch = { 0 };
+	int res = SUCCESS;
+
+	while(virt < end){
+		uint32_t dirIndex = virt >> 22;
+
+		uintptr_t next = (virt & ~0x3FFFFF) + 0x400000;
+		if(next > end){
+			next = end;
+		}
+
+		if(!(src->entry[dirIndex] & FPAGING_P)){
+			virt = next;
+			continue;
+		}
+
+		if(!(dst->entry[dirIndex] & FPAGING_P)){
+			void* newTable = pgtable_alloc();
+			if(!newTable){
+				res = NO_MEMORY;
+				break;
+			}
+
+			dst->entry[dirIndex] = (PagingTable)newTable | FPAGING_P | FPAGING_RW | FPAGING_US;
+			dst->tableCount++;
+		}
+
+		PagingTable* from = (PagingTable*)kmap((void*)(src->entry[dirIndex] & PAGE_MASK));
+		PagingTable* to = (PagingTable*)kmap((void*)(dst->entry[dirIndex] & PAGE_MASK));
+		if(!from || !to){
+			kunmap(from);
+			kunmap(to);
+			res = OUT_OF_VMEM;
+			break;
+		}
+
+		for(; virt < next; virt += PAGING_PAGE_SIZE){
+			uint32_t tblIndex = (virt >> 12) & 0x3FF;
+			if(to[tblIndex]){
+				continue;
+			}
+
+			// Both copies point at the slot, the first fault in either reads it back
+			if(paging_is_swap_entry(from[tblIndex]) && isPrivate){
+				swap_dup(paging_swap_slot(from[tblIndex]));
+
+				to[tblIndex] = from[tblIndex];
+				dst->entryCount[dirIndex]++;
+				continue;
+			}
+
+			if(!(from[tblIndex] & FPAGING_P)){
+				continue;
+			}
+
+			if(isPrivate){
+				page_ref((void*)(from[tblIndex] & PAGE_MASK));
+
+				if(from[tblIndex] & FPAGING_RW){
+					from[tblIndex] &= ~FPAGING_RW;
+
+					if(current){
+						paging_tlb_batch_add(&batch, (void*)virt);
+					}
+				}
+			}
+
+			to[tblIndex] = from[tblIndex];
+			dst->entryCount[dirIndex]++;
+		}
+
+		kunmap(from);
+		kunmap(to);
+	}
+
+	paging_tlb_batch_finish(&batch);
+
+	return res;
+}
+
+// Apply flags to the mapped pages of a range, pages that are read-only stay so
+// and get their write bit back through the copy-on-write fault
+int mmu_protect_pages(struct PagingDirectory* directory, void* virtualStart, uint32_t size, uint8_t flags){
+	if(!directory){
+		return NULL_PTR;
+	}
+
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(virtualStart);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualStart + size));
+
+	if(end < virt || end > KERNEL_VIRT_BASE){
+		return OUT_OF_BOUNDS;
+	}
+
+	uint8_t current = (directory == _currentDirectory);
+	struct TlbBatch batch = { 0 };
+
+	while(virt < end){
+		uint32_t dirIndex = virt >> 22;
+
+		uintptr_t next = (virt & ~0x3FFFFF) + 0x400000;
+		if(next > end){
+			next = end;
+		}
+
+		if(!(directory->entry[dirIndex] & FPAGING_P)){
+			virt = next;
+			continue;
+		}
+
+		PagingTable* table = (PagingTable*)kmap((void*)(directory->entry[dirIndex] & PAGE_MASK));
+		if(!table){
+			paging_tlb_batch_finish(&batch);
+			return OUT_OF_VMEM;
+		}
+
+		for(; virt < next; virt += PAGING_PAGE_SIZE){
+			uint32_t tblIndex = (virt >> 12) & 0x3FF;
+			if(!(table[tblIndex] & FPAGING_P)){
+				continue;
+			}
+
+			uint8_t pageFlags = flags | FPAGING_P;
+			if(!(table[tblIndex] & FPAGING_RW)){
+				pageFlags &= ~FPAGING_RW;
+			}
+
+			// Accessed and dirty feed page reclaim, see memory/swap.c
+			table[tblIndex] = (table[tblIndex] & (PAGE_MASK | FPAGING_A | FPAGING_D)) | pageFlags;
+
+			if(current){
+				paging_tlb_batch_add(&batch, (void*)virt);
+			}
+		}
+
+		kunmap(table);
+	}
+
+	paging_tlb_batch_finish(&batch);
+
+	return SUCCESS;
+}
+
 void* mmu_translate(void* virtualAddr){
 	return paging_translate(virtualAddr);
 }
@@ -333,15 +714,65 @@ uint8_t mmu_user_pointer_valid_range(const void* userPtr, size_t size){
     return 1;
 }
 
+// User half only, the kernel tables are shared by every directory.
+// Swapped out pages keep their table and are counted as resident.
+void mmu_directory_stats(struct PagingDirectory* directory, uint32_t* tables, uint32_t* residentPages){
+	*tables = 0;
+	*residentPages = 0;
+
+	for(uint32_t i = 0; i < PAGING_USER_TABLES; i++){
+		if(directory->entryCount[i]){
+			(*tables)++;
+			*residentPages += directory->entryCount[i];
+		}
+	}
+}
+
 void* phys_to_virt(void* physicalAddr){
 	return (void*)((uintptr_t)physicalAddr + KERNEL_VIRT_BASE - KERNEL_PHYS_BASE);
 }
 
+// Kernel entries never change after mmu_init, a single copy keeps the directory in sync
 void mmu_copy_kernel_to_directory(struct PagingDirectory* directory){
-	for (uint16_t i = (KERNEL_VIRT_BASE >> 22); i < 1023; i++){
-		directory->entry[i] = _kernelDirectory->entry[i];
-	}
+	memcpy(
+		&directory->entry[PAGING_USER_TABLES],
+		&_kernelDirectory->entry[PAGING_USER_TABLES],
+		PAGING_KERNEL_TABLES * sizeof(uint32_t)
+	);
 
 	// ensurence self PDE
 	directory->entry[SELF_PDE_INDEX] = (PagingTable)((uintptr_t)mmu_translate(directory->entry) | FPAGING_P | FPAGING_RW);
 }
+
+void* kmap(void* physicalAddr){
+	if(!_kmapTable){
+		return 0x0;
+	}
+
+	for(uint32_t i = 0; i < KMAP_SLOTS; i++){
+		if(_kmapUsed & (1u << i)){
+			continue;
+		}
+
+		_kmapUsed |= (1u << i);
+		_kmapTable[i] = ((uintptr_t)physicalAddr & PAGE_MASK) | FPAGING_P | FPAGING_RW | _globalFlag;
+
+		void* virt = (void*)(KMAP_VIRT_BASE + (i * PAGING_PAGE_SIZE));
+		paging_invlpg(virt);
+
+		return virt;
+	}
+
+	return 0x0;
+}
+
+void kunmap(void* virtualAddr){
+	uint32_t i = ((uintptr_t)virtualAddr - KMAP_VIRT_BASE) / PAGING_PAGE_SIZE;
+	if((uintptr_t)virtualAddr < KMAP_VIRT_BASE || i >= KMAP_SLOTS){
+		return;
+	}
+
+	_kmapTable[i] = 0;
+	_kmapUsed &= ~(1u << i);
+	paging_invlpg(virtualAddr);
+}
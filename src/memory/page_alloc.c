@@ -0,0 +1,328 @@
+#include <memory/page_alloc.h>
+#include <memory/kheap.h>
+#include <memory/swap.h>
+#include <core/kernel.h>
+#include <boot/memory.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <stdint.h>
+
+/*
+ * Buddy physical page frame allocator
+ *
+ * Every frame of RAM has a descriptor, free blocks of 2^order frames are
+ * chained by frame number in one list per order. Freeing a block merges it
+ * with its buddy (pfn ^ 2^order) for as long as the buddy is a free block
+ * of the same order.
+ *
+ * Allocated blocks are reference counted so frames can be shared between
+ * address spaces (copy-on-write), free_pages() only returns a block once
+ * its last reference is dropped.
+ *
+ * Single frames fall back on swap_reclaim() when the lists run dry.
+ *
+ * Usable RAM comes from the E820 map. The kernel image, its stack, the DMA
+ * pool and the heap window stay reserved, everything else is handed out to
+ * page tables and user memory.
+ */
+
+#define _NIL 0xFFFFFFFF
+
+// Frames are addressed with 32 bits, memory above 4 GiB is ignored
+#define _PHYS_LIMIT 0xFFFFF000ull
+
+#define _FRAME_RESERVED 0x1
+#define _FRAME_FREE     0x2 // Head of a free block
+#define _FRAME_ALLOC    0x4 // Head of an allocated block
+
+struct page_frame {
+	uint32_t next;
+	uint32_t prev;
+	uint16_t refs;
+	uint8_t order;
+	uint8_t flags;
+}__attribute__((packed));
+
+static struct page_frame* _frames = 0x0;
+static uint32_t _frameCount = 0;
+
+static uint32_t _freeLists[PAGE_ORDERS];
+
+static uint32_t _freePages = 0;
+static uint32_t _totalPages = 0;
+
+static inline uint32_t _pfn(void* addr){
+	return (uintptr_t)addr / PAGING_PAGE_SIZE;
+}
+
+static void _list_push(uint32_t pfn, uint32_t order){
+	struct page_frame* frame = &_frames[pfn];
+
+	frame->order = order;
+	frame->flags = _FRAME_FREE;
+	frame->prev = _NIL;
+	frame->next = _freeLists[order];
+
+	if(_freeLists[order] != _NIL){
+		_frames[_freeLists[order]].prev = pfn;
+	}
+
+	_freeLists[order] = pfn;
+}
+
+static void _list_remove(uint32_t pfn){
+	struct page_frame* frame = &_frames[pfn];
+
+	if(frame->prev != _NIL){
+		_frames[frame->prev].next = frame->next;
+	}else{
+		_freeLists[frame->order] = frame->next;
+	}
+
+	if(frame->next != _NIL){
+		_frames[frame->next].prev = frame->prev;
+	}
+
+	frame->flags &= ~_FRAME_FREE;
+}
+
+static void _free_block(uint32_t pfn, uint32_t order){
+	while(order < PAGE_ORDER_MAX){
+		uint32_t buddy = pfn ^ (1u << order);
+		if(buddy >= _frameCount){
+			break;
+		}
+
+		struct page_frame* b = &_frames[buddy];
+		if(!(b->flags & _FRAME_FREE) || b->order != order){
+			break;
+		}
+
+		_list_remove(buddy);
+		pfn &= ~(1u << order);
+		order++;
+	}
+
+	_list_push(pfn, order);
+}
+
+// Hand [start, end) to the allocator minus what the kernel already owns
+static void _add_usable(uint64_t start, uint64_t end){
+	uint64_t reserved[][2] = {
+		{ 0x0, KERNEL_STACK_PHYS_TOP }, // BIOS data, boot code and the kernel image/stack
+		{ DMA_PHYS_BASE, DMA_PHYS_BASE + DMA_POOL_SIZE },
+		{ HEAP_PHYS_BASE, HEAP_PHYS_BASE + kheap_size() },
+	};
+
+	if(end > _PHYS_LIMIT){
+		end = _PHYS_LIMIT;
+	}
+
+	for(uint32_t i = 0; i < sizeof(reserved) / sizeof(reserved[0]) && start < end; i++){
+		if(reserved[i][1] <= start || reserved[i][0] >= end){
+			continue;
+		}
+
+		if(reserved[i][0] > start){
+			page_alloc_add_range((uintptr_t)start, (uintptr_t)reserved[i][0]);
+		}
+
+		start = reserved[i][1];
+	}
+
+	if(start < end){
+		page_alloc_add_range((uintptr_t)start, (uintptr_t)end);
+	}
+}
+
+// Must run before mmu_init(), the E820 map is only mapped by the boot directory
+int page_alloc_init(){
+	struct E820Map* map = (struct E820Map*)E820_MAP_ADDR;
+
+	uint64_t memoryEnd = map->count ? 0 : PHYS_MEMORY_DEFAULT_END;
+	for(uint32_t i = 0; i < map->count && i < E820_MAX_ENTRIES; i++){
+		struct E820Entry* entry = &map->entries[i];
+		if(entry->type == E820_USABLE && entry->base + entry->length > memoryEnd){
+			memoryEnd = entry->base + entry->length;
+		}
+	}
+
+	if(memoryEnd > _PHYS_LIMIT){
+		memoryEnd = _PHYS_LIMIT;
+	}
+
+	_frameCount = memoryEnd / PAGING_PAGE_SIZE;
+
+	_frames = (struct page_frame*)kcalloc(_frameCount, sizeof(struct page_frame));
+	if(!_frames){
+		return NO_MEMORY;
+	}
+
+	for(uint32_t i = 0; i < _frameCount; i++){
+		_frames[i].flags = _FRAME_RESERVED;
+	}
+
+	for(int i = 0; i < PAGE_ORDERS; i++){
+		_freeLists[i] = _NIL;
+	}
+
+	_freePages = 0;
+	_totalPages = 0;
+
+	if(!map->count){
+		_add_usable(0x0, PHYS_MEMORY_DEFAULT_END);
+	}
+
+	for(uint32_t i = 0; i < map->count && i < E820_MAX_ENTRIES; i++){
+		struct E820Entry* entry = &map->entries[i];
+		if(entry->type == E820_USABLE){
+			_add_usable(entry->base, entry->base + entry->length);
+		}
+	}
+
+	return _totalPages ? SUCCESS : NO_MEMORY;
+}
+
+int page_alloc_add_range(uintptr_t start, uintptr_t end){
+	if(!_frames){
+		return NOT_READY;
+	}
+
+	uint32_t pfn = _pfn(paging_align_address((void*)start));
+	uint32_t last = _pfn(paging_align_to_lower((void*)end));
+
+	if(last > _frameCount){
+		last = _frameCount;
+	}
+
+	if(pfn >= last){
+		return INVALID_ARG;
+	}
+
+	for(uint32_t i = pfn; i < last; i++){
+		if(!(_frames[i].flags & _FRAME_RESERVED)){
+			return ALREADY_MAPD;
+		}
+	}
+
+	_freePages += last - pfn;
+	_totalPages += last - pfn;
+
+	while(pfn < last){
+		uint32_t order = 0;
+		while(order < PAGE_ORDER_MAX &&
+			!(pfn & ((2u << order) - 1)) &&
+			pfn + (2u << order) <= last)
+		{
+			order++;
+		}
+
+		for(uint32_t i = 0; i < (1u << order); i++){
+			_frames[pfn + i].flags = 0;
+		}
+
+		_free_block(pfn, order);
+		pfn += 1u << order;
+	}
+
+	return SUCCESS;
+}
+
+static void* _alloc_block(uint32_t order){
+	if(!_frames || order > PAGE_ORDER_MAX){
+		return 0x0;
+	}
+
+	uint32_t current = order;
+	while(current <= PAGE_ORDER_MAX && _freeLists[current] == _NIL){
+		current++;
+	}
+
+	if(current > PAGE_ORDER_MAX){
+		return 0x0;
+	}
+
+	uint32_t pfn = _freeLists[current];
+	_list_remove(pfn);
+
+	// Split down, the upper halves go back to the free lists
+	while(current > order){
+		current--;
+		_list_push(pfn + (1u << current), current);
+	}
+
+	_frames[pfn].order = order;
+	_frames[pfn].flags = _FRAME_ALLOC;
+	_frames[pfn].refs = 1;
+	_freePages -= 1u << order;
+
+	return (void*)((uintptr_t)pfn * PAGING_PAGE_SIZE);
+}
+
+void* alloc_pages(uint32_t order){
+	void* block = _alloc_block(order);
+
+	// Reclaimed frames are scattered, only worth it for a single one
+	if(!block && !order && swap_reclaim(SWAP_RECLAIM_BATCH)){
+		block = _alloc_block(order);
+	}
+
+	return block;
+}
+
+// Head descriptor of an allocated block, 0x0 if physicalAddr is not one
+static struct page_frame* _alloc_frame(void* physicalAddr){
+	uint32_t pfn = _pfn(physicalAddr);
+
+	if(!_frames || ((uintptr_t)physicalAddr & (PAGING_PAGE_SIZE - 1)) || pfn >= _frameCount){
+		return 0x0;
+	}
+
+	if(!(_frames[pfn].flags & _FRAME_ALLOC)){
+		return 0x0;
+	}
+
+	return &_frames[pfn];
+}
+
+void free_pages(void* physicalAddr, uint32_t order){
+	struct page_frame* frame = _alloc_frame(physicalAddr);
+	if(!frame || frame->order != order){
+		warning("free_pages(): frame 0x%x is not an order %d block\n", physicalAddr, order);
+		return;
+	}
+
+	if(--frame->refs){
+		return; // Still mapped somewhere else
+	}
+
+	uint32_t pfn = _pfn(physicalAddr);
+
+	frame->flags = 0;
+	_freePages += 1u << order;
+
+	_free_block(pfn, order);
+}
+
+void page_ref(void* physicalAddr){
+	struct page_frame* frame = _alloc_frame(physicalAddr);
+	if(!frame || frame->refs == 0xFFFF){
+		warning("page_ref(): bad frame 0x%x\n", physicalAddr);
+		return;
+	}
+
+	frame->refs++;
+}
+
+uint32_t page_ref_count(void* physicalAddr){
+	struct page_frame* frame = _alloc_frame(physicalAddr);
+	return frame ? frame->refs : 0;
+}
+
+uint32_t page_alloc_free_count(){
+	return _freePages;
+}
+
+uint32_t page_alloc_total_count(){
+	return _totalPages;
+}
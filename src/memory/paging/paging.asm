@@ -15,7 +15,7 @@ paging_enable:
 	push ebp
 	mov ebp, esp
 	mov eax, cr0
-	or eax, 0x80000000
+	or eax, 0x80010000 ; PG | WP
 	mov cr0, eax
 	pop ebp
 	ret
@@ -1,7 +1,11 @@
 #include "drivers/terminal.h"
 #include <mmu.h>
+#include <memory/page_alloc.h>
+#include <memory/pgtable.h>
 #include <core/kernel.h>
+#include <arch/i386/cpu.h>
 #include <def/status.h>
+#include <def/config.h>
 #include <stdint.h>
 
 /*
@@ -12,9 +16,7 @@
 	(((uintptr_t)(virt) & (PAGING_PAGE_SIZE - 1)) || \
 	((uintptr_t)(phys) & (PAGING_PAGE_SIZE - 1)))
 
-static inline void _invlpg(void* virtAddr){
-	__asm__ volatile("invlpg (%0)" : : "r"(virtAddr) : "memory");
-}
+static uint32_t _flushThreshold = TLB_INVLPG_THRESHOLD;
 
 static inline void _get_indexes(void* virtualAddr, uint32_t* outDirIndex, uint32_t* outTabIndex){
 	uintptr_t virt = (uintptr_t)virtualAddr;
@@ -32,6 +34,10 @@ void* paging_translate(void* virtualAddr){
 		return 0;
 	}
 
+	if (pde & FPAGING_PS) {
+		return (void*)((pde & LARGE_PAGE_MASK) | (virt & (PAGING_LARGE_PAGE_SIZE - 1)));
+	}
+
 	uint32_t* pt = VIRT_PTBL(dir_idx);
 	uint32_t pte = pt[tbl_idx];
 	if (!(pte & FPAGING_P)) {
@@ -42,6 +48,19 @@ void* paging_translate(void* virtualAddr){
 	return (void*)phys;
 }
 
+// Entry of a 4 KiB page in the loaded directory, 0x0 without a table
+PagingTable* paging_pte(void* virtualAddr){
+	uint32_t dirIndex, tblIndex;
+	_get_indexes(virtualAddr, &dirIndex, &tblIndex);
+
+	uint32_t pde = VIRT_PDIR[dirIndex];
+	if (!(pde & FPAGING_P) || (pde & FPAGING_PS)) {
+		return 0x0;
+	}
+
+	return &VIRT_PTBL(dirIndex)[tblIndex];
+}
+
 struct PagingDirectory* paging_new_directory(){
     struct PagingDirectory* directory = (struct PagingDirectory*)kcalloc(sizeof(struct PagingDirectory), 1);
     if (!directory){
@@ -63,11 +82,10 @@ void paging_free_directory(struct PagingDirectory *directory){
 		panic("paging_free_directory(): Trying to free current directory!");
 	}
 
+	// Shared kernel tables and the self PDE were already dropped by the caller
 	for (int i = 0; i < PAGING_TOTAL_ENTRIES_PER_TABLE; i++) {
-		if (directory->entry[i] & FPAGING_P) {
-			PagingTable* pte = (PagingTable*)VIRT_PTBL(i);
-			kfree(pte);
-
+		if (i != SELF_PDE_INDEX && (directory->entry[i] & FPAGING_P)) {
+			free_page((void*)(directory->entry[i] & PAGE_MASK));
 			directory->entry[i] = 0;
 		}
 	}
@@ -87,23 +105,61 @@ int paging_map(void* virtualAddr, void* physicalAddr, uint8_t flags){
 	uint32_t* pde = VIRT_PDIR;
 	PagingTable* pte = VIRT_PTBL(dirIndex);
 
+	if (pde[dirIndex] & FPAGING_PS) {
+		return ALREADY_MAPD;
+	}
+
 	if (!(pde[dirIndex] & FPAGING_P)) {
-		void* newTable = kcalloc(PAGING_TOTAL_ENTRIES_PER_TABLE, sizeof(uint32_t));
+		void* newTable = pgtable_alloc();
 		if (!newTable) {
 			return NO_MEMORY;
 		}
 
-		pde[dirIndex] = (PagingTable)paging_translate(newTable) | flags;
-		pte = VIRT_PTBL(dirIndex);
+		// Permissions are enforced per page, keep the directory entry permissive
+		pde[dirIndex] = (PagingTable)newTable | FPAGING_P | FPAGING_RW | (flags & FPAGING_US);
+		paging_invlpg(pte);
+
 		_currentDirectory->tableCount++;
 	}
 
-	if (pte[tblIndex] & FPAGING_P) {
+	if (pte[tblIndex] & (FPAGING_P | FPAGING_SWAP)) {
 		return ALREADY_MAPD;
 	}
 
 	pte[tblIndex] = ((uintptr_t)physicalAddr & PAGE_MASK) | flags;
 
+	if (dirIndex < PAGING_USER_TABLES) {
+		_currentDirectory->entryCount[dirIndex]++;
+	}
+
+	return SUCCESS;
+}
+
+// Point an existing mapping at another frame or change its flags
+int paging_remap(void* virtualAddr, void* physicalAddr, uint8_t flags){
+	if(_ADDRS_NOT_ALING(virtualAddr, physicalAddr)){
+		return BAD_ALIGNMENT;
+	}
+
+	uint32_t dirIndex, tblIndex;
+	_get_indexes(virtualAddr, &dirIndex, &tblIndex);
+
+	if (!(VIRT_PDIR[dirIndex] & FPAGING_P)) {
+		return ALREADY_UMAPD;
+	}
+
+	if (VIRT_PDIR[dirIndex] & FPAGING_PS) {
+		return INVALID_ARG;
+	}
+
+	PagingTable* pte = VIRT_PTBL(dirIndex);
+	if (!(pte[tblIndex] & FPAGING_P)) {
+		return ALREADY_UMAPD;
+	}
+
+	pte[tblIndex] = ((uintptr_t)physicalAddr & PAGE_MASK) | flags;
+	paging_invlpg(virtualAddr);
+
 	return SUCCESS;
 }
 
@@ -116,23 +172,26 @@ int paging_unmap(void* virtualAddr){
         return ALREADY_UMAPD;
     }
 
+	if (pde[dirIndex] & FPAGING_PS) {
+		return INVALID_ARG;
+	}
+
 	PagingTable* pte = VIRT_PTBL(dirIndex);
 	if (!(pte[tblIndex] & FPAGING_P)) {
 		return ALREADY_UMAPD;
 	}
 
 	pte[tblIndex] = 0;
-    _invlpg(virtualAddr);
+    paging_invlpg(virtualAddr);
 
-	for (int i = 0; i < PAGING_TOTAL_ENTRIES_PER_TABLE; i++) {
-		if (pte[i] & FPAGING_P) {
-			return SUCCESS;
-		}
+	// Kernel half tables live as long as the directory
+	if (dirIndex >= PAGING_USER_TABLES || --_currentDirectory->entryCount[dirIndex]) {
+		return SUCCESS;
 	}
 
-	kfree(pte);
+	pgtable_free((void*)(pde[dirIndex] & PAGE_MASK));
     pde[dirIndex] = 0;
-    _invlpg((void*)((uintptr_t)dirIndex << 22));
+    paging_invlpg(pte);
 	_currentDirectory->tableCount--;
 
 	return SUCCESS;
@@ -151,13 +210,104 @@ int paging_map_range(int count, void* virtualAddr, void* physicalAddr, uint8_t f
 	return SUCCESS;
 }
 
+// Clears a table at a time, stops at the first hole
 int paging_unmap_range(int count, void* virtualAddr){
-	for (int i = 0; i < count; i++) {
-		int status = paging_unmap(virtualAddr);
-		if (status != SUCCESS)
-			return status;
+	struct TlbBatch batch = { 0 };
+	uint32_t* pde = VIRT_PDIR;
 
-		virtualAddr = (void*)((uintptr_t)virtualAddr + PAGING_PAGE_SIZE);
+	uintptr_t virt = (uintptr_t)paging_align_to_lower(virtualAddr);
+	uintptr_t end = virt + ((uintptr_t)count * PAGING_PAGE_SIZE);
+	int status = SUCCESS;
+
+	while (virt < end && status == SUCCESS) {
+		uint32_t dirIndex = virt >> 22;
+
+		uintptr_t next = (virt & LARGE_PAGE_MASK) + PAGING_LARGE_PAGE_SIZE;
+		if (!next || next > end) {
+			next = end;
+		}
+
+		if (!(pde[dirIndex] & FPAGING_P)) {
+			status = ALREADY_UMAPD;
+			break;
+		}
+
+		if (pde[dirIndex] & FPAGING_PS) {
+			status = INVALID_ARG;
+			break;
+		}
+
+		PagingTable* pte = VIRT_PTBL(dirIndex);
+		for (; virt < next; virt += PAGING_PAGE_SIZE) {
+			uint32_t tblIndex = (virt >> 12) & 0x3FF;
+			if (!(pte[tblIndex] & FPAGING_P)) {
+				status = ALREADY_UMAPD;
+				break;
+			}
+
+			pte[tblIndex] = 0;
+			paging_tlb_batch_add(&batch, (void*)virt);
+
+			if (dirIndex < PAGING_USER_TABLES) {
+				_currentDirectory->entryCount[dirIndex]--;
+			}
+		}
+
+		// Kernel half tables live as long as the directory
+		if (dirIndex < PAGING_USER_TABLES && !_currentDirectory->entryCount[dirIndex]) {
+			pgtable_free((void*)(pde[dirIndex] & PAGE_MASK));
+			pde[dirIndex] = 0;
+			paging_tlb_batch_add(&batch, pte);
+			_currentDirectory->tableCount--;
+		}
 	}
-	return SUCCESS;
+
+	paging_tlb_batch_finish(&batch);
+
+	return status;
+}
+
+void paging_flush_tlb(){
+	write_cr3(read_cr3());
+}
+
+void paging_flush_tlb_all(){
+	uint32_t cr4 = read_cr4();
+
+	if(cr4 & CR4_PGE){
+		// Toggling PGE drops global entries too
+		write_cr4(cr4 & ~CR4_PGE);
+		write_cr4(cr4);
+	}else{
+		paging_flush_tlb();
+	}
+}
+
+// Invalidate one changed page of the current directory, invlpg until the threshold is passed
+void paging_tlb_batch_add(struct TlbBatch* batch, void* virtualAddr){
+	// The recursive table window is per directory, never global
+	if ((uintptr_t)virtualAddr >= KERNEL_VIRT_BASE && virtualAddr < (void*)VIRT_PTBL(0)) {
+		batch->global = 1;
+	}
+
+	if (++batch->pages <= _flushThreshold) {
+		paging_invlpg(virtualAddr);
+	}
+}
+
+void paging_tlb_batch_finish(struct TlbBatch* batch){
+	if (batch->pages > _flushThreshold) {
+		if (batch->global) {
+			paging_flush_tlb_all();
+		} else {
+			paging_flush_tlb();
+		}
+	}
+
+	batch->pages = 0;
+	batch->global = 0;
+}
+
+void paging_set_flush_threshold(uint32_t pages){
+	_flushThreshold = pages;
 }
@@ -0,0 +1,76 @@
+#include <memory/pgtable.h>
+#include <memory/page_alloc.h>
+#include <memory/paging.h>
+#include <arch/i386/cpu.h>
+#include <def/config.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * Page table frame pool
+ *
+ * New page tables must start zeroed. The pool keeps up to
+ * PGTABLE_POOL_SIZE frames taken from the pre-zeroed page pool by the idle
+ * task, so paging_map() does not pay for the allocation and the memset inline.
+ * Tables that are freed because they became empty are already zero and go
+ * straight back into the pool.
+ */
+
+static void* _pool[PGTABLE_POOL_SIZE];
+static uint32_t _poolCount = 0;
+
+void* pgtable_alloc(){
+	uint32_t flags = cpu_irq_save();
+
+	void* frame = 0x0;
+	if(_poolCount){
+		frame = _pool[--_poolCount];
+	}
+
+	cpu_irq_restore(flags);
+
+	return frame ? frame : alloc_zeroed_page();
+}
+
+void pgtable_free(void* physicalAddr){
+	uint32_t flags = cpu_irq_save();
+
+	if(_poolCount < PGTABLE_POOL_SIZE){
+		_pool[_poolCount++] = physicalAddr;
+		physicalAddr = 0x0;
+	}
+
+	cpu_irq_restore(flags);
+
+	if(physicalAddr){
+		free_page(physicalAddr);
+	}
+}
+
+uint32_t pgtable_pool_refill(uint32_t pages){
+	uint32_t added = 0;
+
+	while(added < pages){
+		// The page allocator and the kmap slots are not reentrant, one frame per critical section
+		uint32_t flags = cpu_irq_save();
+
+		void* frame = 0x0;
+		if(_poolCount < PGTABLE_POOL_SIZE && (frame = alloc_zeroed_page())){
+			_pool[_poolCount++] = frame;
+		}
+
+		cpu_irq_restore(flags);
+
+		if(!frame){
+			break;
+		}
+
+		added++;
+	}
+
+	return added;
+}
+
+uint32_t pgtable_pool_count(){
+	return _poolCount;
+}
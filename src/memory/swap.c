@@ -0,0 +1,445 @@
+#include <memory/swap.h>
+#include <memory/page_alloc.h>
+#include <memory/vma_tree.h>
+#include <memory/paging.h>
+#include <memory/kheap.h>
+#include <core/process.h>
+#include <core/kernel.h>
+#include <core/sched.h>
+#include <core/sched/wait.h>
+#include <io/stream.h>
+#include <fs/vfs.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * Swap of private user pages
+ *
+ * The swap file is preallocated on the root volume and must sit in one
+ * run of clusters, its device range is looked up once through vfs_bmap()
+ * and slots are then read and written on the block device directly.
+ *
+ * When alloc_pages() runs dry, swap_reclaim() turns a clock hand over
+ * the pages of every process. A page that was accessed since the last
+ * pass loses its accessed bit and is kept (second chance). A cold page
+ * that is still clean and backed by the executable is dropped, the next
+ * fault reads it again, any other one is written to a free slot and its
+ * entry is replaced by the slot number (see paging_swap_entry()).
+ *
+ * There is no reverse map, frames shared by fork() are skipped. Slot
+ * I/O sleeps, the I/O buffer is owned by one task at a time and the
+ * page is looked up again afterwards (see _recheck()).
+ */
+
+#define _NO_SLOT 0xFFFFFFFF
+
+static struct file _device;
+static struct file* _file = 0x0;
+static uint64_t _start = 0;
+
+// Live for as long as swap is on, movable so they do not pin the middle of the heap
+static struct HeapHandle* _slotRefs = 0x0;
+static uint32_t _slotCount = 0;
+static uint32_t _slotsUsed = 0;
+static uint32_t _slotHint = 0;
+
+static struct HeapHandle* _ioBuffer = 0x0;
+static uint8_t* _io = 0x0; // _ioBuffer, pinned between _lock() and _unlock()
+static uint8_t _busy = 0;
+static struct wait_queue_head _busyWait;
+
+// Clock hand, index in _processes and user address
+static uint32_t _handProcess = 0;
+static uintptr_t _handAddr = 0;
+
+extern struct Process* _processes[PROC_MAX];
+
+int swap_on(const char* path){
+	if(_slotRefs){
+		return ALREADY_MAPD;
+	}
+
+	struct stat st;
+	int res = vfs_getattr(path, &st);
+	if(IS_STAT_ERR(res)){
+		return res;
+	}
+
+	if(st.size < PAGING_PAGE_SIZE){
+		return INVALID_ARG;
+	}
+
+	struct file* file = vfs_open(path, FMODE_READ);
+	if(IS_ERR_OR_NULL(file)){
+		return file ? PTR_ERR(file) : NOT_FOUND;
+	}
+
+	struct file_extent extent;
+	res = vfs_bmap(file, 0, &extent);
+	if(res == SUCCESS && (extent.length < st.size || (extent.start % SECTOR_SIZE) || !extent.bdev)){
+		res = INVALID_FILE; // Fragmented, slots must map straight to sectors
+	}
+
+	if(res != SUCCESS){
+		vfs_close(file);
+		return res;
+	}
+
+	_slotCount = st.size / PAGING_PAGE_SIZE;
+	_slotRefs = kmalloc_movable(_slotCount);
+	_ioBuffer = kmalloc_movable(PAGING_PAGE_SIZE);
+	if(!_slotRefs || !_ioBuffer){
+		kfree_movable(_slotRefs);
+		kfree_movable(_ioBuffer);
+		_slotRefs = 0x0;
+		_ioBuffer = 0x0;
+		_slotCount = 0;
+		vfs_close(file);
+		return NO_MEMORY;
+	}
+
+	memset(kmovable_pin(_slotRefs), 0x0, _slotCount);
+	kmovable_unpin(_slotRefs);
+
+	memset(&_device, 0x0, sizeof(_device));
+	_device.f_op = (struct file_operations*)extent.bdev->ops;
+	_device.private_data = extent.bdev->dev->driver_data;
+
+	_file = file; // Kept open for as long as the slots are in use
+	_start = extent.start;
+	wait_queue_init(&_busyWait);
+
+	return SUCCESS;
+}
+
+static int _slot_io(uint32_t slot, uint8_t write){
+	_device.pos = _start + (uint64_t)slot * PAGING_PAGE_SIZE;
+
+	int res = write ?
+		_device.f_op->write(&_device, _io, PAGING_PAGE_SIZE) :
+		_device.f_op->read(&_device, _io, PAGING_PAGE_SIZE);
+
+	return IS_STAT_ERR(res) ? res : SUCCESS;
+}
+
+static uint32_t _slot_alloc(){
+	uint8_t* refs = kmovable_pin(_slotRefs);
+	uint32_t slot = _NO_SLOT;
+
+	for(uint32_t i = 0; i < _slotCount; i++){
+		uint32_t index = (_slotHint + i) % _slotCount;
+		if(!refs[index]){
+			refs[index] = 1;
+			_slotHint = index + 1;
+			_slotsUsed++;
+			slot = index;
+			break;
+		}
+	}
+
+	kmovable_unpin(_slotRefs);
+
+	return slot;
+}
+
+void swap_dup(uint32_t slot){
+	uint8_t* refs = slot < _slotCount ? kmovable_pin(_slotRefs) : 0x0;
+
+	if(!refs || !refs[slot] || refs[slot] == 0xFF){
+		warning("swap_dup(): bad slot %d\n", slot);
+	}else{
+		refs[slot]++;
+	}
+
+	if(refs){
+		kmovable_unpin(_slotRefs);
+	}
+}
+
+void swap_free(uint32_t slot){
+	uint8_t* refs = slot < _slotCount ? kmovable_pin(_slotRefs) : 0x0;
+
+	if(!refs || !refs[slot]){
+		warning("swap_free(): bad slot %d\n", slot);
+	}else if(!--refs[slot]){
+		_slotsUsed--;
+	}
+
+	if(refs){
+		kmovable_unpin(_slotRefs);
+	}
+}
+
+void swap_stats(uint32_t* slots, uint32_t* used){
+	*slots = _slotCount;
+	*used = _slotsUsed;
+}
+
+// Slot I/O sleeps, compaction from the idle task must not move the buffer meanwhile
+static inline void _lock(){
+	(void)wait_event(&_busyWait, !_busy);
+	_busy = 1;
+	_io = kmovable_pin(_ioBuffer);
+}
+
+static inline void _unlock(){
+	kmovable_unpin(_ioBuffer);
+	_io = 0x0;
+	_busy = 0;
+	wake_up_one(&_busyWait);
+}
+
+// Table entry of page in directory, kmap()ed, 0x0 without a table
+static PagingTable* _map_entry(struct PagingDirectory* directory, uintptr_t page){
+	PagingTable pde = directory->entry[page >> 22];
+	if(!(pde & FPAGING_P) || (pde & FPAGING_PS)){
+		return 0x0;
+	}
+
+	PagingTable* table = (PagingTable*)kmap((void*)(pde & PAGE_MASK));
+	return table ? &table[(page >> 12) & 0x3FF] : 0x0;
+}
+
+static inline void _unmap_entry(PagingTable* pte){
+	kunmap(paging_align_to_lower(pte));
+}
+
+static inline void _flush(struct PagingDirectory* directory, uintptr_t page){
+	if(directory == _currentDirectory){
+		paging_invlpg((void*)page);
+	}
+}
+
+// A clean page the fault path rebuilds from the executable or zeroes
+static uint8_t _refillable(struct mm_struct* mm, uintptr_t page){
+	struct mem_region* region = vma_tree_first_after(mm, page);
+	for(; region && (uintptr_t)region->virtualBaseAddress < page + PAGING_PAGE_SIZE; region = vma_next(region)){
+		if(region->type == VMA_ANONYMOUS){
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Entry of page again after sleeping on the disk, 0x0 if the address
+ * space or the entry changed. The process and its mm may have exited
+ * and been reused at the same addresses, mm is only read once a live
+ * process owns it and the generation tells a new one apart.
+ */
+static PagingTable* _recheck(uint32_t index, struct mm_struct* mm, uint32_t generation, struct PagingDirectory* directory, uintptr_t page, PagingTable entry){
+	struct Process* owner = _processes[index];
+	if(!owner || owner->mm != mm || mm->generation != generation || mm->pageDirectory != directory){
+		return 0x0;
+	}
+
+	PagingTable* pte = _map_entry(directory, page);
+	if(pte && *pte != entry){
+		_unmap_entry(pte);
+		return 0x0;
+	}
+
+	return pte;
+}
+
+/*
+ * Write the page to a slot, then swap the entry if nobody touched it.
+ * The entry has no accessed bit and no TLB entry, any use of the page
+ * while the slot is written changes it and the page keeps its frame.
+ */
+static int _swap_out(struct Process* process, struct PagingDirectory* directory, uintptr_t page, PagingTable entry){
+	uint32_t index = process->pid - 1;
+	void* frame = (void*)(entry & PAGE_MASK);
+
+	// Captured before sleeping, process may be gone once the slot is written
+	struct mm_struct* mm = process->mm;
+	uint32_t generation = mm->generation;
+
+	uint32_t slot = _slot_alloc();
+	void* data = slot != _NO_SLOT ? kmap(frame) : 0x0;
+
+	int res = NO_MEMORY;
+	if(data){
+		memcpy(_io, data, PAGING_PAGE_SIZE);
+		kunmap(data);
+
+		res = _slot_io(slot, 1);
+	}
+
+	PagingTable* pte = _recheck(index, mm, generation, directory, page, entry);
+	if(!pte){
+		res = INVALID_STATE;
+	}else if(res == SUCCESS && page_ref_count(frame) != 1){
+		res = INVALID_STATE;
+	}
+
+	if(res != SUCCESS){
+		if(pte){
+			_unmap_entry(pte);
+		}
+
+		if(slot != _NO_SLOT){
+			swap_free(slot);
+		}
+
+		return res;
+	}
+
+	*pte = paging_swap_entry(slot);
+	_unmap_entry(pte);
+	_flush(directory, page);
+
+	free_page(frame);
+
+	return SUCCESS;
+}
+
+// 1 if the frame behind page went back to the allocator
+static uint8_t _reclaim_page(struct Process* process, uintptr_t page){
+	struct PagingDirectory* directory = process->mm->pageDirectory;
+
+	PagingTable* pte = _map_entry(directory, page);
+	if(!pte){
+		return 0;
+	}
+
+	PagingTable entry = *pte;
+	void* frame = (void*)(entry & PAGE_MASK);
+
+	if(!(entry & FPAGING_P) || page_ref_count(frame) != 1){
+		_unmap_entry(pte);
+		return 0;
+	}
+
+	if(entry & FPAGING_A){
+		*pte = entry & ~FPAGING_A;
+		_unmap_entry(pte);
+		_flush(directory, page);
+		return 0;
+	}
+
+	if(!(entry & FPAGING_D) && _refillable(process->mm, page)){
+		*pte = 0;
+		directory->entryCount[page >> 22]--;
+		_unmap_entry(pte);
+		_flush(directory, page);
+
+		free_page(frame);
+		return 1;
+	}
+
+	_unmap_entry(pte);
+
+	return _swap_out(process, directory, page, entry) == SUCCESS;
+}
+
+uint32_t swap_reclaim(uint32_t pages){
+	struct Task* task = pcb_current();
+
+	// The idle task polls the disk and must not sleep
+	if(!_slotRefs || !task || !task->tid){
+		return 0;
+	}
+
+	_lock();
+
+	uint32_t freed = 0;
+	uint32_t steps = page_alloc_total_count() * 2 + PROC_MAX;
+
+	for(; freed < pages && steps; steps--){
+		struct Process* process = _processes[_handProcess];
+		struct mm_struct* mm = process ? process->mm : 0x0;
+
+		struct mem_region* region = 0x0;
+		if(mm && mm->pageDirectory){
+			region = vma_tree_first_after(mm, _handAddr);
+		}
+
+		if(!region){
+			_handProcess = (_handProcess + 1) % PROC_MAX;
+			_handAddr = 0;
+			continue;
+		}
+
+		uintptr_t page = (uintptr_t)paging_align_to_lower(region->virtualBaseAddress);
+		if(page < _handAddr){
+			page = _handAddr;
+		}
+
+		// Device and shared mappings are not ours to page out
+		if(!region->isPrivite || region->physBaseAddress){
+			_handAddr = (uintptr_t)region->virtualEndAddress;
+			continue;
+		}
+
+		PagingTable pde = mm->pageDirectory->entry[page >> 22];
+		if(!(pde & FPAGING_P) || (pde & FPAGING_PS)){
+			_handAddr = (page & ~0x3FFFFF) + 0x400000;
+			continue;
+		}
+
+		_handAddr = page + PAGING_PAGE_SIZE;
+		freed += _reclaim_page(process, page);
+	}
+
+	_unlock();
+
+	return freed;
+}
+
+int swap_in(struct mem_region* region, void* page){
+	uint8_t flags = region->flags;
+
+	void* frame = alloc_page();
+	if(!frame){
+		return NO_MEMORY;
+	}
+
+	_lock();
+
+	PagingTable* pte = paging_pte(page);
+	if(!pte || !paging_is_swap_entry(*pte)){
+		_unlock();
+		free_page(frame);
+		return SUCCESS; // Brought back while waiting
+	}
+
+	PagingTable entry = *pte;
+	uint32_t slot = paging_swap_slot(entry);
+
+	int res = _slot_io(slot, 0);
+	if(res == SUCCESS){
+		void* data = kmap(frame);
+		if(data){
+			memcpy(data, _io, PAGING_PAGE_SIZE);
+			kunmap(data);
+		}else{
+			res = OUT_OF_VMEM;
+		}
+	}
+
+	_unlock();
+
+	if(res != SUCCESS){
+		free_page(frame);
+		return res;
+	}
+
+	// Another task of the process may have faulted it in or unmapped it meanwhile
+	pte = paging_pte(page);
+	if(!pte || *pte != entry){
+		free_page(frame);
+		return SUCCESS;
+	}
+
+	// Only in memory from now on, the next reclaim writes it again
+	*pte = (uintptr_t)frame | flags | FPAGING_D;
+	paging_invlpg(page);
+
+	swap_free(slot);
+
+	return SUCCESS;
+}
@@ -1,21 +1,86 @@
 #include <mmu.h>
+#include <memory/vma_tree.h>
+#include <memory/slab.h>
+#include <memory/page_alloc.h>
+#include <memory/swap.h>
+#include <memory/kheap.h>
+#include <fs/vfs.h>
 #include <def/err.h>
 
+static struct kmem_cache _regionCache = KMEM_CACHE_INIT("mem_region", sizeof(struct mem_region));
+
 struct mem_region* vma_lookup(struct mm_struct* mm, void* virtualAddr){
 	if(!mm || !virtualAddr){
 		return 0x0;
 	}
 
-	struct mem_region* region = mm->regions;
-	while(region){
-		if(virtualAddr >= region->virtualBaseAddress && virtualAddr < region->virtualEndAddress){
-			return region;
-		}
+	// Faults come in runs on the same region
+	struct mem_region* region = mm->lookupCache;
+	if(region && virtualAddr >= region->virtualBaseAddress && virtualAddr < region->virtualEndAddress){
+		return region;
+	}
 
-		region = region->next;
+	region = vma_tree_lookup(mm, (uintptr_t)virtualAddr);
+	if(region){
+		mm->lookupCache = region;
 	}
 
-	return 0x0;
+	return region;
+}
+
+static struct mem_region* _vma_insert(struct mm_struct* mm, void* virtualAddr, uint32_t size, uint8_t flags){
+	struct mem_region* region = (struct mem_region*)kmem_cache_zalloc(&_regionCache);
+	if (!region) {
+		return 0x0;
+	}
+
+	region->virtualBaseAddress = virtualAddr;
+	region->virtualEndAddress = paging_align_address((void*)((uintptr_t)virtualAddr + size));
+
+	region->flags = flags;
+	region->size = size;
+
+	vma_tree_insert(mm, region);
+
+	return region;
+}
+
+static void _vma_free(struct mm_struct* mm, struct mem_region* region){
+	vma_tree_remove(mm, region);
+	kmem_cache_free(&_regionCache, region);
+}
+
+// Anonymous neighbours with the same flags become one region
+static inline uint8_t _vma_can_merge(struct mem_region* low, struct mem_region* high){
+	return low->virtualEndAddress == high->virtualBaseAddress &&
+		low->type == VMA_ANONYMOUS && high->type == VMA_ANONYMOUS &&
+		low->isPrivite && high->isPrivite &&
+		!low->physBaseAddress && !high->physBaseAddress &&
+		low->flags == high->flags;
+}
+
+static struct mem_region* _vma_merge(struct mm_struct* mm, struct mem_region* region){
+	struct mem_region* prev = vma_prev(region);
+	if(prev && _vma_can_merge(prev, region)){
+		prev->size = ((uintptr_t)region->virtualBaseAddress + region->size) - (uintptr_t)prev->virtualBaseAddress;
+		prev->virtualEndAddress = region->virtualEndAddress;
+
+		_vma_free(mm, region);
+		vma_tree_update(mm, prev);
+
+		region = prev;
+	}
+
+	struct mem_region* next = vma_next(region);
+	if(next && _vma_can_merge(region, next)){
+		region->size = ((uintptr_t)next->virtualBaseAddress + next->size) - (uintptr_t)region->virtualBaseAddress;
+		region->virtualEndAddress = next->virtualEndAddress;
+
+		_vma_free(mm, next);
+		vma_tree_update(mm, region);
+	}
+
+	return region;
 }
 
 int vma_add(struct mm_struct* mm, void* virtualAddr, void* physicalAddr, uint32_t size, uint8_t flags, uint8_t isPrivate){
@@ -23,83 +88,459 @@ int vma_add(struct mm_struct* mm, void* virtualAddr, void* physicalAddr, uint32_
 		return NULL_PTR;
 	}
 
-	struct mem_region* region = (struct mem_region*)kzalloc(sizeof(struct mem_region));
+	struct mem_region* region = _vma_insert(mm, virtualAddr, size, flags);
 	if (!region) {
 		return NO_MEMORY;
 	}
 
 	region->physBaseAddress = physicalAddr;
+	region->isPrivite = isPrivate;
+	region->type = VMA_ANONYMOUS;
 
-	region->virtualBaseAddress = virtualAddr;
-	region->virtualEndAddress = paging_align_address((void*)((uintptr_t)virtualAddr + size));
+	_vma_merge(mm, region);
 
-	region->flags = flags;
-	region->size = size;
-	region->isPrivite = isPrivate;
+	return SUCCESS;
+}
+
+int vma_add_file(struct mm_struct* mm, void* virtualAddr, uint32_t size, uint8_t flags, struct file* file, uint32_t offset, uint32_t fileSize){
+	if (!mm || !mm->pageDirectory || !file) {
+		return NULL_PTR;
+	}
+
+	if (fileSize > size) {
+		return INVALID_ARG;
+	}
 
-	region->next = mm->regions;
-	mm->regions = region;
+	struct mem_region* region = _vma_insert(mm, virtualAddr, size, flags);
+	if (!region) {
+		return NO_MEMORY;
+	}
+
+	region->isPrivite = 1;
+	region->type = fileSize ? VMA_FILE : VMA_ZERO;
+
+	region->file = file;
+	region->fileOffset = offset;
+	region->fileSize = fileSize;
 
 	return SUCCESS;
 }
 
-int vma_remove(struct mm_struct* mm, void* virtualAddr, uint32_t size){
-	if (!mm || !mm->pageDirectory) {
+// Copy the file contents of every region overlapping the page into buffer, segments may share one
+static int _fill_from_files(struct mm_struct* mm, uintptr_t page, uint8_t* buffer){
+	struct mem_region* region = vma_tree_first_after(mm, page);
+	for (; region && (uintptr_t)region->virtualBaseAddress < page + PAGING_PAGE_SIZE; region = vma_next(region)) {
+		if (region->type != VMA_FILE) {
+			continue;
+		}
+
+		uintptr_t dataStart = (uintptr_t)region->virtualBaseAddress;
+		uintptr_t dataEnd = dataStart + region->fileSize;
+
+		uintptr_t start = page > dataStart ? page : dataStart;
+		uintptr_t end = (page + PAGING_PAGE_SIZE) < dataEnd ? (page + PAGING_PAGE_SIZE) : dataEnd;
+
+		if (start >= end) {
+			continue;
+		}
+
+		// The file may be shared with a forked mm, its position is left alone
+		int read = vfs_pread(region->file, buffer + (start - page), end - start, region->fileOffset + (start - dataStart));
+		if (IS_STAT_ERR(read) || (uint32_t)read != end - start) {
+			return READ_FAIL;
+		}
+	}
+
+	return SUCCESS;
+}
+
+// Write to a page shared by fork(), the last owner keeps the frame
+static int _copy_on_write(struct mm_struct* mm, struct mem_region* region, void* page){
+	void* shared = paging_align_to_lower(paging_translate(page));
+
+	if (page_ref_count(shared) == 1) {
+		return paging_remap(page, shared, region->flags);
+	}
+
+	// May reclaim, the page can be swapped out or become ours meanwhile
+	void* frame = alloc_page();
+	if (!frame) {
+		return NO_MEMORY;
+	}
+
+	if (paging_align_to_lower(paging_translate(page)) != shared || page_ref_count(shared) == 1) {
+		free_page(frame);
+		return SUCCESS; // Faults again and takes the fresh state
+	}
+
+	void* copy = kmap(frame);
+	if (!copy) {
+		free_page(frame);
+		return OUT_OF_VMEM;
+	}
+
+	memcpy(copy, page, PAGING_PAGE_SIZE);
+	kunmap(copy);
+
+	int res = paging_remap(page, frame, region->flags);
+	if (res != SUCCESS) {
+		free_page(frame);
+		return res;
+	}
+
+	free_page(shared);
+
+	return SUCCESS;
+}
+
+// Back the page holding virtualAddr, mm must be the loaded address space
+int vma_fault(struct mm_struct* mm, struct mem_region* region, void* virtualAddr){
+	if (!mm || !region) {
+		return NULL_PTR;
+	}
+
+	void* page = paging_align_to_lower(virtualAddr);
+
+	PagingTable* pte = paging_pte(page);
+	if (pte && paging_is_swap_entry(*pte)) {
+		return swap_in(region, page);
+	}
+
+	if (paging_translate(page)) {
+		return _copy_on_write(mm, region, page);
+	}
+
+	void* frame = alloc_zeroed_page();
+	if (!frame) {
+		return NO_MEMORY;
+	}
+
+	int res;
+
+	// Filled through a kernel mapping, reclaim only sees the frame once the PTE is installed
+	if (region->type == VMA_FILE) {
+		void* buffer = kmap(frame);
+		if (!buffer) {
+			free_page(frame);
+			return OUT_OF_VMEM;
+		}
+
+		res = _fill_from_files(mm, (uintptr_t)page, buffer);
+		kunmap(buffer);
+
+		if (res != SUCCESS) {
+			free_page(frame);
+			return res;
+		}
+	}
+
+	// Allocation and reads may sleep, another task of the mm can fault the page in meanwhile
+	pte = paging_pte(page);
+	if (paging_translate(page) || (pte && paging_is_swap_entry(*pte))) {
+		free_page(frame);
+		return SUCCESS;
+	}
+
+	res = paging_map(page, frame, region->flags);
+	if (res != SUCCESS) {
+		free_page(frame);
+	}
+
+	return res;
+}
+
+// Fault in a range ahead of time
+int vma_populate(struct mm_struct* mm, void* virtualAddr, uint32_t size){
+	if (!mm) {
 		return NULL_PTR;
 	}
 
-	struct mem_region* prev = NULL;
-	struct mem_region* current = mm->regions;
+	uintptr_t addr = (uintptr_t)virtualAddr;
+	uintptr_t end = addr + size;
 
-	while (current) {
-		if (current->virtualBaseAddress == virtualAddr && current->size == size) {
-			if (prev) {
-				prev->next = current->next;
-			} else {
-				mm->regions = current->next;
+	while (addr < end) {
+		if (!paging_translate((void*)addr)) {
+			struct mem_region* region = vma_lookup(mm, (void*)addr);
+			if (!region) {
+				return NOT_FOUND;
 			}
 
-			if(current->physBaseAddress){
-				kfree(current->physBaseAddress);
+			int res = vma_fault(mm, region, (void*)addr);
+			if (res != SUCCESS) {
+				return res;
 			}
+		}
 
-			kfree(current);
-			break;
+		addr = (uintptr_t)paging_align_to_lower((void*)addr) + PAGING_PAGE_SIZE;
+	}
+
+	return SUCCESS;
+}
+
+// Empty address space, without a page directory yet
+struct mm_struct* mm_alloc(){
+	static uint32_t generation = 0;
+
+	struct mm_struct* mm = (struct mm_struct*)kzalloc(sizeof(struct mm_struct));
+	if (mm) {
+		mm->generation = ++generation;
+	}
+
+	return mm;
+}
+
+// Duplicate the regions of src into dst, pages are shared until written
+int vma_fork(struct mm_struct* dst, struct mm_struct* src){
+	if (!dst || !src || !dst->pageDirectory || !src->pageDirectory) {
+		return NULL_PTR;
+	}
+
+	if (src->exeFile) {
+		dst->exeFile = get_file(src->exeFile);
+	}
+
+	dst->mmapBase = src->mmapBase;
+	dst->brkStart = src->brkStart;
+	dst->brk = src->brk;
+
+	for (struct mem_region* region = vma_first(src); region; region = vma_next(region)) {
+		struct mem_region* copy = (struct mem_region*)kmem_cache_alloc(&_regionCache);
+		if (!copy) {
+			return NO_MEMORY;
+		}
+
+		memcpy(copy, region, sizeof(struct mem_region));
+
+		if (copy->file == src->exeFile) {
+			copy->file = dst->exeFile;
+		}
+
+		vma_tree_insert(dst, copy);
+
+		int res = mmu_share_pages(dst->pageDirectory, src->pageDirectory, region->virtualBaseAddress, region->size, region->isPrivite);
+		if (res != SUCCESS) {
+			return res;
 		}
-		prev = current;
-		current = current->next;
 	}
 
 	return SUCCESS;
 }
 
-int vma_clean(struct mm_struct* mm){
-	if (!mm) {
+// Split region at addr, the upper part becomes its own region
+static int _vma_split(struct mm_struct* mm, struct mem_region* region, uintptr_t addr){
+	struct mem_region* upper = (struct mem_region*)kmem_cache_alloc(&_regionCache);
+	if (!upper) {
+		return NO_MEMORY;
+	}
+
+	uint32_t offset = addr - (uintptr_t)region->virtualBaseAddress;
+
+	memcpy(upper, region, sizeof(struct mem_region));
+
+	upper->virtualBaseAddress = (void*)addr;
+	upper->size = region->size - offset;
+
+	if (region->physBaseAddress) {
+		upper->physBaseAddress = (void*)((uintptr_t)region->physBaseAddress + offset);
+	}
+
+	if (region->type == VMA_FILE) {
+		upper->fileOffset += offset;
+		upper->fileSize = region->fileSize > offset ? region->fileSize - offset : 0;
+		upper->type = upper->fileSize ? VMA_FILE : VMA_ZERO;
+
+		if (region->fileSize > offset) {
+			region->fileSize = offset;
+		}
+	}
+
+	region->virtualEndAddress = (void*)addr;
+	region->size = offset;
+
+	vma_tree_update(mm, region);
+	vma_tree_insert(mm, upper);
+
+	return SUCCESS;
+}
+
+// Cut the regions crossing the edges of [start, end), so the range is made of whole regions
+static int _vma_split_range(struct mm_struct* mm, uintptr_t start, uintptr_t end){
+	struct mem_region* region = vma_tree_first_after(mm, start);
+
+	for (; region && (uintptr_t)region->virtualBaseAddress < end; region = vma_next(region)) {
+		uintptr_t base = (uintptr_t)region->virtualBaseAddress;
+		uintptr_t top = (uintptr_t)region->virtualEndAddress;
+
+		int res = SUCCESS;
+		if (base < start && top > start) {
+			res = _vma_split(mm, region, start);
+		} else if (base < end && top > end) {
+			res = _vma_split(mm, region, end);
+		}
+
+		if (res != SUCCESS) {
+			return res;
+		}
+	}
+
+	return SUCCESS;
+}
+
+static inline uint8_t _vma_inside(struct mem_region* region, uintptr_t start, uintptr_t end){
+	return (uintptr_t)region->virtualBaseAddress >= start && (uintptr_t)region->virtualEndAddress <= end;
+}
+
+// Every page of [start, end) in some region, overlapping segments included
+static uint8_t _vma_range_covered(struct mm_struct* mm, uintptr_t start, uintptr_t end){
+	uintptr_t covered = start;
+
+	struct mem_region* region = vma_tree_first_after(mm, start);
+	for (; region && covered < end; region = vma_next(region)) {
+		if ((uintptr_t)region->virtualBaseAddress > covered) {
+			return 0;
+		}
+
+		if ((uintptr_t)region->virtualEndAddress > covered) {
+			covered = (uintptr_t)region->virtualEndAddress;
+		}
+	}
+
+	return covered >= end;
+}
+
+uint8_t vma_range_free(struct mm_struct* mm, void* virtualAddr, uint32_t size){
+	uintptr_t start = (uintptr_t)paging_align_to_lower(virtualAddr);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualAddr + size));
+
+	struct mem_region* region = vma_tree_first_after(mm, start);
+	return !region || (uintptr_t)region->virtualBaseAddress >= end;
+}
+
+// Lowest free range of size bytes at or above virtualAddr, 0x0 if none
+void* vma_find_free(struct mm_struct* mm, void* virtualAddr, uint32_t size){
+	uintptr_t low = (uintptr_t)paging_align_address(virtualAddr);
+	size = (uint32_t)paging_align_address((void*)size);
+
+	while (size && low + size > low && low + size <= KERNEL_VIRT_BASE) {
+		uintptr_t addr = vma_tree_find_gap(mm, low, size);
+		if (addr + size < addr || addr + size > KERNEL_VIRT_BASE) {
+			break;
+		}
+
+		// Gaps are measured from the previous region only, overlapping segments can hide one
+		if (vma_range_free(mm, (void*)addr, size)) {
+			return (void*)addr;
+		}
+
+		low = addr + PAGING_PAGE_SIZE;
+	}
+
+	return 0x0;
+}
+
+// Unmap [virtualAddr, virtualAddr + size), regions partially inside are split
+int vma_remove(struct mm_struct* mm, void* virtualAddr, uint32_t size){
+	if (!mm || !mm->pageDirectory) {
 		return NULL_PTR;
 	}
 
-	struct mem_region* current = mm->regions;
-	while (current) {
-		struct mem_region* next = current->next;
+	uintptr_t start = (uintptr_t)paging_align_to_lower(virtualAddr);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualAddr + size));
 
-		if(current->isPrivite){
-			if(current->virtualBaseAddress && current->size > 0){
-				mmu_unmap_pages(current->virtualBaseAddress, current->size);
-			}
+	int res = _vma_split_range(mm, start, end);
+	if (res != SUCCESS) {
+		return res;
+	}
+
+	struct mem_region* current = vma_tree_first_after(mm, start);
+	while (current && (uintptr_t)current->virtualBaseAddress < end) {
+		struct mem_region* next = vma_next(current);
 
-			if(current->physBaseAddress){
-				kfree(current->physBaseAddress);
+		if (_vma_inside(current, start, end)) {
+			if(current->isPrivite){
+				mmu_release_pages(mm->pageDirectory, current->virtualBaseAddress, current->size);
 			}
 
-			kfree(current);
+			_vma_free(mm, current);
 		}
-		
+
 		current = next;
 	}
 
 	return SUCCESS;
 }
 
+// Change the page flags of [virtualAddr, virtualAddr + size)
+int vma_protect(struct mm_struct* mm, void* virtualAddr, uint32_t size, uint8_t flags){
+	if (!mm || !mm->pageDirectory) {
+		return NULL_PTR;
+	}
+
+	uintptr_t start = (uintptr_t)paging_align_to_lower(virtualAddr);
+	uintptr_t end = (uintptr_t)paging_align_address((void*)((uintptr_t)virtualAddr + size));
+
+	// Like mprotect(), a hole anywhere fails the call before anything changed
+	if (!_vma_range_covered(mm, start, end)) {
+		return NO_MEMORY;
+	}
+
+	int res = _vma_split_range(mm, start, end);
+	if (res != SUCCESS) {
+		return res;
+	}
+
+	res = NOT_FOUND;
+
+	struct mem_region* region = vma_tree_first_after(mm, start);
+	while (region && (uintptr_t)region->virtualBaseAddress < end) {
+		if (!_vma_inside(region, start, end)) {
+			region = vma_next(region);
+			continue;
+		}
+
+		region->flags = flags;
+		res = mmu_protect_pages(mm->pageDirectory, region->virtualBaseAddress, region->size, flags);
+		if (res != SUCCESS) {
+			return res;
+		}
+
+		// Pieces split off earlier join back once their flags match again
+		region = vma_next(_vma_merge(mm, region));
+	}
+
+	return res;
+}
+
+static void _vma_free_subtree(struct mm_struct* mm, struct mem_region* region){
+	if (!region) {
+		return;
+	}
+
+	_vma_free_subtree(mm, region->left);
+	_vma_free_subtree(mm, region->right);
+
+	// Private regions own their frames
+	if(region->isPrivite && mm->pageDirectory && region->size > 0){
+		mmu_release_pages(mm->pageDirectory, region->virtualBaseAddress, region->size);
+	}
+
+	kmem_cache_free(&_regionCache, region);
+}
+
+int vma_clean(struct mm_struct* mm){
+	if (!mm) {
+		return NULL_PTR;
+	}
+
+	_vma_free_subtree(mm, mm->regions);
+
+	mm->regions = 0x0;
+	mm->lookupCache = 0x0;
+	mm->regionCount = 0;
+
+	return SUCCESS;
+}
+
 int vma_destroy(struct mm_struct* mm){
 	if (!mm) {
 		return NULL_PTR;
@@ -107,6 +548,10 @@ int vma_destroy(struct mm_struct* mm){
 
 	vma_clean(mm);
 
+	if (mm->exeFile) {
+		vfs_close(mm->exeFile);
+	}
+
 	if (mm->pageDirectory) {
 		mmu_destroy_page(mm->pageDirectory);
 	}
@@ -0,0 +1,343 @@
+#include <memory/vma_tree.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * Interval tree of the regions of an address space.
+ *
+ * AVL tree keyed by the region base. Each node also keeps, for its whole
+ * subtree, the highest end address and the largest free gap found right
+ * before a region. The first answers "which region holds addr" and the
+ * second "where does a new mapping fit", both in O(log n).
+ *
+ * ELF segments may share a page, so regions can overlap by less than a
+ * page. The lookup still finds one of them, gap sizes are only measured
+ * against the previous region.
+ */
+
+static inline uintptr_t _base(struct mem_region* region){
+	return (uintptr_t)region->virtualBaseAddress;
+}
+
+static inline uintptr_t _end(struct mem_region* region){
+	return (uintptr_t)region->virtualEndAddress;
+}
+
+static inline int8_t _height(struct mem_region* region){
+	return region ? region->height : 0;
+}
+
+static void _update(struct mem_region* node){
+	struct mem_region* left = node->left;
+	struct mem_region* right = node->right;
+
+	node->height = 1 + (_height(left) > _height(right) ? _height(left) : _height(right));
+
+	node->maxEnd = _end(node);
+	node->maxGap = node->gapBefore;
+
+	if(left){
+		if(left->maxEnd > node->maxEnd) node->maxEnd = left->maxEnd;
+		if(left->maxGap > node->maxGap) node->maxGap = left->maxGap;
+	}
+
+	if(right){
+		if(right->maxEnd > node->maxEnd) node->maxEnd = right->maxEnd;
+		if(right->maxGap > node->maxGap) node->maxGap = right->maxGap;
+	}
+}
+
+static void _set_gap(struct mem_region* node){
+	struct mem_region* prev = vma_prev(node);
+	uintptr_t prevEnd = prev ? _end(prev) : 0;
+
+	node->gapBefore = _base(node) > prevEnd ? _base(node) - prevEnd : 0;
+}
+
+static void _replace_child(struct mm_struct* mm, struct mem_region* parent, struct mem_region* old, struct mem_region* new){
+	if(!parent){
+		mm->regions = new;
+	}else if(parent->left == old){
+		parent->left = new;
+	}else{
+		parent->right = new;
+	}
+
+	if(new){
+		new->parent = parent;
+	}
+}
+
+static struct mem_region* _rotate_left(struct mm_struct* mm, struct mem_region* x){
+	struct mem_region* y = x->right;
+
+	x->right = y->left;
+	if(y->left){
+		y->left->parent = x;
+	}
+
+	_replace_child(mm, x->parent, x, y);
+
+	y->left = x;
+	x->parent = y;
+
+	_update(x);
+	_update(y);
+
+	return y;
+}
+
+static struct mem_region* _rotate_right(struct mm_struct* mm, struct mem_region* x){
+	struct mem_region* y = x->left;
+
+	x->left = y->right;
+	if(y->right){
+		y->right->parent = x;
+	}
+
+	_replace_child(mm, x->parent, x, y);
+
+	y->right = x;
+	x->parent = y;
+
+	_update(x);
+	_update(y);
+
+	return y;
+}
+
+// Rebalance and refresh the subtree values from node up to the root
+static void _fixup(struct mm_struct* mm, struct mem_region* node){
+	while(node){
+		_update(node);
+
+		int balance = _height(node->left) - _height(node->right);
+		if(balance > 1){
+			if(_height(node->left->left) < _height(node->left->right)){
+				_rotate_left(mm, node->left);
+			}
+
+			node = _rotate_right(mm, node);
+		}else if(balance < -1){
+			if(_height(node->right->right) < _height(node->right->left)){
+				_rotate_right(mm, node->right);
+			}
+
+			node = _rotate_left(mm, node);
+		}
+
+		node = node->parent;
+	}
+}
+
+void vma_tree_insert(struct mm_struct* mm, struct mem_region* region){
+	region->left = 0x0;
+	region->right = 0x0;
+	region->parent = 0x0;
+
+	struct mem_region* parent = 0x0;
+	struct mem_region* node = mm->regions;
+
+	while(node){
+		parent = node;
+		node = _base(region) < _base(node) ? node->left : node->right;
+	}
+
+	if(!parent){
+		mm->regions = region;
+	}else if(_base(region) < _base(parent)){
+		parent->left = region;
+	}else{
+		parent->right = region;
+	}
+
+	region->parent = parent;
+	mm->regionCount++;
+
+	_set_gap(region);
+	_fixup(mm, region);
+
+	struct mem_region* next = vma_next(region);
+	if(next){
+		_set_gap(next);
+		_fixup(mm, next);
+	}
+}
+
+void vma_tree_remove(struct mm_struct* mm, struct mem_region* region){
+	struct mem_region* next = vma_next(region);
+	struct mem_region* from;
+
+	if(region->left && region->right){
+		// The successor has no left child, it takes the place of region
+		if(next->parent == region){
+			from = next;
+		}else{
+			from = next->parent;
+
+			from->left = next->right;
+			if(next->right){
+				next->right->parent = from;
+			}
+
+			next->right = region->right;
+			next->right->parent = next;
+		}
+
+		_replace_child(mm, region->parent, region, next);
+
+		next->left = region->left;
+		next->left->parent = next;
+	}else{
+		from = region->parent;
+		_replace_child(mm, region->parent, region, region->left ? region->left : region->right);
+	}
+
+	_fixup(mm, from);
+
+	if(next){
+		_set_gap(next);
+		_fixup(mm, next);
+	}
+
+	if(mm->lookupCache == region){
+		mm->lookupCache = 0x0;
+	}
+
+	region->left = 0x0;
+	region->right = 0x0;
+	region->parent = 0x0;
+	mm->regionCount--;
+}
+
+void vma_tree_update(struct mm_struct* mm, struct mem_region* region){
+	_fixup(mm, region);
+
+	struct mem_region* next = vma_next(region);
+	if(next){
+		_set_gap(next);
+		_fixup(mm, next);
+	}
+}
+
+struct mem_region* vma_tree_lookup(struct mm_struct* mm, uintptr_t addr){
+	struct mem_region* node = mm->regions;
+
+	while(node){
+		if(addr < _base(node)){
+			node = node->left;
+		}else if(addr < _end(node)){
+			return node;
+		}else if(node->left && node->left->maxEnd > addr){
+			node = node->left; // A lower region reaches past addr, so it holds it
+		}else{
+			node = node->right;
+		}
+	}
+
+	return 0x0;
+}
+
+struct mem_region* vma_tree_first_after(struct mm_struct* mm, uintptr_t addr){
+	struct mem_region* node = mm->regions;
+
+	while(node){
+		if(node->left && node->left->maxEnd > addr){
+			node = node->left;
+		}else if(_end(node) > addr){
+			return node;
+		}else{
+			node = node->right;
+		}
+	}
+
+	return 0x0;
+}
+
+// Does the gap in front of node hold size bytes at or above low
+static inline uint8_t _gap_fits(struct mem_region* node, uintptr_t low, uint32_t size){
+	uintptr_t start = _base(node) - node->gapBefore;
+	if(start < low){
+		start = low;
+	}
+
+	return _base(node) >= start && _base(node) - start >= size;
+}
+
+// Lowest region whose gap fits, subtrees with smaller gaps are skipped
+static struct mem_region* _gap_search(struct mem_region* node, uintptr_t low, uint32_t size){
+	if(!node || node->maxGap < size){
+		return 0x0;
+	}
+
+	// Regions below low + size cannot have a fitting gap in front of them
+	if(_base(node) >= low + size){
+		struct mem_region* found = _gap_search(node->left, low, size);
+		if(found){
+			return found;
+		}
+
+		if(_gap_fits(node, low, size)){
+			return node;
+		}
+	}
+
+	return _gap_search(node->right, low, size);
+}
+
+// Lowest free address at or above low with size bytes free, 0 if none
+uintptr_t vma_tree_find_gap(struct mm_struct* mm, uintptr_t low, uint32_t size){
+	struct mem_region* node = _gap_search(mm->regions, low, size);
+
+	uintptr_t addr;
+	if(node){
+		addr = _base(node) - node->gapBefore;
+	}else{
+		addr = mm->regions ? mm->regions->maxEnd : 0; // Past the last region
+	}
+
+	return addr > low ? addr : low;
+}
+
+struct mem_region* vma_first(struct mm_struct* mm){
+	struct mem_region* node = mm->regions;
+	while(node && node->left){
+		node = node->left;
+	}
+
+	return node;
+}
+
+struct mem_region* vma_next(struct mem_region* node){
+	if(node->right){
+		node = node->right;
+		while(node->left){
+			node = node->left;
+		}
+
+		return node;
+	}
+
+	while(node->parent && node->parent->right == node){
+		node = node->parent;
+	}
+
+	return node->parent;
+}
+
+struct mem_region* vma_prev(struct mem_region* node){
+	if(node->left){
+		node = node->left;
+		while(node->right){
+			node = node->right;
+		}
+
+		return node;
+	}
+
+	while(node->parent && node->parent->left == node){
+		node = node->parent;
+	}
+
+	return node->parent;
+}
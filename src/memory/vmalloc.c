@@ -0,0 +1,111 @@
+#include <memory/vmalloc.h>
+#include <memory/vma_tree.h>
+#include <memory/page_alloc.h>
+#include <memory/paging.h>
+#include <memory/slab.h>
+#include <core/kernel.h>
+#include <def/config.h>
+#include <def/err.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * Virtually contiguous kernel allocations
+ *
+ * Big buffers (FAT tables) do not need physically contiguous memory, only
+ * contiguous addresses. vmalloc() carves a range out of
+ * [VMALLOC_VIRT_BASE, VMALLOC_VIRT_END) and backs it page by page with
+ * frames from the page allocator, so it keeps working when the block heap
+ * is too fragmented for a large run.
+ *
+ * The kernel page tables are shared by every directory, a mapping made
+ * here is visible in all address spaces at once. Ranges are tracked in an
+ * interval tree, each one is followed by an unmapped guard page.
+ */
+
+static struct kmem_cache _areaCache = KMEM_CACHE_INIT("vm_area", sizeof(struct mem_region));
+static struct mm_struct _areas;
+
+static void _release(uintptr_t start, uintptr_t end){
+	uint32_t mapped = 0;
+
+	for(uintptr_t virt = start; virt < end; virt += PAGING_PAGE_SIZE){
+		void* frame = paging_translate((void*)virt);
+		if(!frame){
+			break;
+		}
+
+		free_page(frame);
+		mapped++;
+	}
+
+	paging_unmap_range(mapped, (void*)start);
+}
+
+static void* _vmalloc(size_t size, uint8_t zeroed){
+	if(!size || size > VMALLOC_VIRT_END - VMALLOC_VIRT_BASE){
+		return 0x0;
+	}
+
+	size = (size_t)paging_align_address((void*)size);
+
+	uintptr_t start = vma_tree_find_gap(&_areas, VMALLOC_VIRT_BASE, size + PAGING_PAGE_SIZE);
+	if(start + size + PAGING_PAGE_SIZE > VMALLOC_VIRT_END || start + size < start){
+		return 0x0;
+	}
+
+	struct mem_region* area = (struct mem_region*)kmem_cache_zalloc(&_areaCache);
+	if(!area){
+		return 0x0;
+	}
+
+	area->virtualBaseAddress = (void*)start;
+	area->virtualEndAddress = (void*)(start + size + PAGING_PAGE_SIZE); // Guard page included
+	area->size = size;
+	area->flags = FPAGING_P | FPAGING_RW;
+	area->type = VMA_ANONYMOUS;
+
+	for(uintptr_t virt = start; virt < start + size; virt += PAGING_PAGE_SIZE){
+		void* frame = zeroed ? alloc_zeroed_page() : alloc_page();
+		if(!frame || paging_map((void*)virt, frame, area->flags) != SUCCESS){
+			if(frame){
+				free_page(frame);
+			}
+
+			_release(start, virt);
+			kmem_cache_free(&_areaCache, area);
+
+			return 0x0;
+		}
+	}
+
+	vma_tree_insert(&_areas, area);
+
+	return (void*)start;
+}
+
+void* vmalloc(size_t size){
+	return _vmalloc(size, 0);
+}
+
+void* vzalloc(size_t size){
+	return _vmalloc(size, 1);
+}
+
+void vfree(void* ptr){
+	if(!ptr){
+		return;
+	}
+
+	struct mem_region* area = vma_tree_lookup(&_areas, (uintptr_t)ptr);
+	if(!area || area->virtualBaseAddress != ptr){
+		warning("vfree(): 0x%x was not returned by vmalloc()\n", ptr);
+		return;
+	}
+
+	uintptr_t start = (uintptr_t)area->virtualBaseAddress;
+	_release(start, start + area->size);
+
+	vma_tree_remove(&_areas, area);
+	kmem_cache_free(&_areaCache, area);
+}
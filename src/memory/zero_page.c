@@ -0,0 +1,91 @@
+#include <memory/page_alloc.h>
+#include <memory/paging.h>
+#include <arch/i386/cpu.h>
+#include <def/config.h>
+#include <mmu.h>
+#include <stdint.h>
+
+/*
+ * Pre-zeroed page pool
+ *
+ * Demand-zero faults (stacks, BSS, anonymous memory) and new page tables
+ * need cleared frames. Once the pool falls under ZERO_POOL_LOW the idle task
+ * zeroes frames until it holds ZERO_POOL_HIGH again, so the memset leaves
+ * the fault and process creation paths. An empty pool zeroes inline.
+ */
+
+static void* _pool[ZERO_POOL_HIGH];
+static uint32_t _poolCount = 0;
+static uint8_t _refilling = 1;
+
+static inline void _clear_page(void* virt){
+	uint32_t count = PAGING_PAGE_SIZE / sizeof(uint32_t);
+	__asm__ volatile("rep stosl" : "+D"(virt), "+c"(count) : "a"(0) : "memory");
+}
+
+static void* _zeroed_frame(){
+	void* frame = alloc_page();
+	if(!frame){
+		return 0x0;
+	}
+
+	void* virt = kmap(frame);
+	if(!virt){
+		free_page(frame);
+		return 0x0;
+	}
+
+	_clear_page(virt);
+	kunmap(virt);
+
+	return frame;
+}
+
+void* alloc_zeroed_page(){
+	uint32_t flags = cpu_irq_save();
+
+	void* frame = 0x0;
+	if(_poolCount){
+		frame = _pool[--_poolCount];
+	}
+
+	if(_poolCount < ZERO_POOL_LOW){
+		_refilling = 1;
+	}
+
+	cpu_irq_restore(flags);
+
+	return frame ? frame : _zeroed_frame();
+}
+
+uint32_t zero_pool_refill(uint32_t pages){
+	uint32_t added = 0;
+
+	while(added < pages && _refilling){
+		// The page allocator and the kmap slots are not reentrant, one frame per critical section
+		uint32_t flags = cpu_irq_save();
+
+		void* frame = 0x0;
+		if(_poolCount < ZERO_POOL_HIGH && (frame = _zeroed_frame())){
+			_pool[_poolCount++] = frame;
+		}
+
+		if(_poolCount >= ZERO_POOL_HIGH){
+			_refilling = 0;
+		}
+
+		cpu_irq_restore(flags);
+
+		if(!frame){
+			break;
+		}
+
+		added++;
+	}
+
+	return added;
+}
+
+uint32_t zero_pool_count(){
+	return _poolCount;
+}
@@ -0,0 +1,161 @@
+/*
+ * Host benchmark for the block heap allocator.
+ *
+ * Runs the same fragmenting alloc/free mix against the kernel heap
+ * (src/memory/heap/heap.c) and against the previous linear first-fit scan,
+ * and prints the average cost of each operation.
+ */
+
+#include <memory/heap.h>
+#include <def/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define TOTAL_BLOCKS (HEAP_SIZE_DEFAULT / HEAP_BLOCK_SIZE)
+#define LIVE_MAX 1024
+#define OPERATIONS 200000
+
+/* Legacy allocator: linear scan from block 0 on every allocation */
+
+static uint8_t legacyTable[TOTAL_BLOCKS];
+
+static int legacy_alloc(uint32_t blocks){
+	uint32_t run = 0;
+	int start = -1;
+
+	for (uint32_t i = 0; i < TOTAL_BLOCKS; i++){
+		if (legacyTable[i] == 0){
+			if (start == -1)
+				start = i;
+
+			if (++run == blocks){
+				memset(&legacyTable[start], 1, blocks);
+				return start;
+			}
+		}else{
+			run = 0;
+			start = -1;
+		}
+	}
+
+	return -1;
+}
+
+static void legacy_free(int start, uint32_t blocks){
+	memset(&legacyTable[start], 0, blocks);
+}
+
+/* Workload */
+
+struct Live{
+	void* ptr;
+	int block;
+	uint32_t blocks;
+};
+
+static struct Live live[LIVE_MAX];
+static uint32_t sizes[OPERATIONS];
+static uint32_t victims[OPERATIONS];
+
+static double _now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Mostly small requests with a tail of big ones, the classic fragmenting mix
+static void _prepare_workload(){
+	srand(0xC0FFEE);
+	for (int i = 0; i < OPERATIONS; i++){
+		int r = rand() % 100;
+		sizes[i] = r < 70 ? 1 + rand() % 2 : (r < 95 ? 3 + rand() % 14 : 32 + rand() % 96);
+		victims[i] = rand();
+	}
+}
+
+static double _run_index(struct Heap* heap, uint32_t* failures){
+	int count = 0;
+	*failures = 0;
+
+	double start = _now();
+	for (int i = 0; i < OPERATIONS; i++){
+		if (count == LIVE_MAX || (count > LIVE_MAX / 2 && (victims[i] & 1))){
+			int v = victims[i] % count;
+			hfree(heap, live[v].ptr);
+			live[v] = live[--count];
+			continue;
+		}
+
+		void* ptr = hmalloc(heap, sizes[i] * HEAP_BLOCK_SIZE);
+		if (!ptr){
+			(*failures)++;
+			continue;
+		}
+
+		live[count++].ptr = ptr;
+	}
+	double end = _now();
+
+	while (count)
+		hfree(heap, live[--count].ptr);
+
+	return (end - start) / OPERATIONS;
+}
+
+static double _run_legacy(uint32_t* failures){
+	int count = 0;
+	*failures = 0;
+
+	double start = _now();
+	for (int i = 0; i < OPERATIONS; i++){
+		if (count == LIVE_MAX || (count > LIVE_MAX / 2 && (victims[i] & 1))){
+			int v = victims[i] % count;
+			legacy_free(live[v].block, live[v].blocks);
+			live[v] = live[--count];
+			continue;
+		}
+
+		int block = legacy_alloc(sizes[i]);
+		if (block < 0){
+			(*failures)++;
+			continue;
+		}
+
+		live[count].block = block;
+		live[count++].blocks = sizes[i];
+	}
+	double end = _now();
+
+	return (end - start) / OPERATIONS;
+}
+
+int main(){
+	static struct Heap heap;
+	static struct HeapTable table;
+
+	void* memory = aligned_alloc(HEAP_BLOCK_SIZE, HEAP_SIZE_DEFAULT);
+	table.blockEntries = malloc(TOTAL_BLOCKS);
+	table.total = TOTAL_BLOCKS;
+
+	if (!memory || !table.blockEntries || create_heap(&heap, &table, memory, (uint8_t*)memory + HEAP_SIZE_DEFAULT) != 0){
+		fprintf(stderr, "failed to create heap\n");
+		return 1;
+	}
+
+	_prepare_workload();
+
+	uint32_t indexFailures, legacyFailures;
+	double legacy = _run_legacy(&legacyFailures);
+	double index = _run_index(&heap, &indexFailures);
+
+	printf("blocks: %u, operations: %d, live max: %d\n", TOTAL_BLOCKS, OPERATIONS, LIVE_MAX);
+	printf("linear scan : %8.1f ns/op (%u failed)\n", legacy, legacyFailures);
+	printf("extent index: %8.1f ns/op (%u failed)\n", index, indexFailures);
+	printf("free blocks after run: %u\n", heap.freeBlocks);
+
+	return 0;
+}
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Build and run the host heap benchmark.
+# usage: tools/bench/heap/run.sh
+
+set -e
+
+root="$(cd "$(dirname "$0")/../../.." && pwd)"
+out="${TMPDIR:-/tmp}/heap_bench"
+
+${CC:-gcc} -O2 -I"$root/src/include" -Wno-builtin-declaration-mismatch \
+	"$root/tools/bench/heap/heap_bench.c" "$root/src/memory/heap/heap.c" -o "$out"
+
+"$out"
@@ -109,6 +109,12 @@ def main():
 
         cmd.cp(fs, ['-ex'], os.path.join(bins, "init.bin"), '/boot/init.bin')
         cmd.cp(fs, ['-ex'], os.path.join(bins, "kernel.bin"), '/boot/kernel.bin')
+
+        # Written last in one go so its clusters are contiguous, the kernel swaps to it directly
+        fs.create(2, 'swap', attr.ARCHIVE | attr.SYSTEM | attr.HIDDEN)
+
+        swapSize = int(conf["SWAP_SIZE"])
+        fs.write(fs.open('/swap'), bytes(swapSize), swapSize)
         return 0
     
     fs = FATFS(img)